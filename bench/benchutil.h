@@ -0,0 +1,54 @@
+#ifndef BENCHUTIL_H
+#define BENCHUTIL_H
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace Bench {
+
+struct Measurement {
+    unsigned long iterations = 0;
+    double nanosPerOp = 0.0;
+
+    double perSecond() const { return nanosPerOp > 0.0 ? 1e9 / nanosPerOp : 0.0; }
+    // Throughput over `bytes` processed by every operation, in MB/s.
+    double megabytesPerSecond(size_t bytes) const { return perSecond() * bytes / (1024.0 * 1024.0); }
+};
+
+// Keeps the compiler from dropping a computation whose result is otherwise unused.
+template<typename T>
+inline void keep(const T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Runs `op` once to warm up, then repeatedly until `budget` is spent.
+template<typename F>
+Measurement measure(F &&op, std::chrono::milliseconds budget = std::chrono::milliseconds(300)) {
+    op();
+
+    Measurement m;
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + budget;
+    auto now = start;
+    do {
+        op();
+        ++m.iterations;
+        now = std::chrono::steady_clock::now();
+    } while (now < deadline);
+
+    m.nanosPerOp = std::chrono::duration<double, std::nano>(now - start).count() / m.iterations;
+    return m;
+}
+
+inline std::string readFile(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+}
+
+#endif
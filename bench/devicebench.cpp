@@ -0,0 +1,85 @@
+// Opens several emulated devices through DeviceManager with the stub libPasspR40.so:
+// checks that every device gets its own library instance and callbacks and keeps its own
+// results, and reports how long concurrent scans on all devices take.
+#include "devicemanager.h"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+
+#ifndef STUB_PASSPR40_PATH
+#define STUB_PASSPR40_PATH "libStubPasspR40.so"
+#endif
+
+namespace {
+
+const intptr_t processMode = RPRM_GetImage_Modes_GetImages | RPRM_GetImage_Modes_OCR_MRZ;
+const int devices = 3;
+const int processMs = 100;
+
+int failures = 0;
+
+void check(bool ok, const std::string &what) {
+    std::cout << (ok ? "ok      " : "FAILED  ") << what << std::endl;
+    if (!ok) {
+        ++failures;
+    }
+}
+
+}
+
+int main(int argc, char **argv) {
+    setenv("STUB_DEVICES", std::to_string(devices).c_str(), 1);
+    setenv("STUB_PROCESS_MS", std::to_string(processMs).c_str(), 1);
+    setenv("STUB_LEXICAL_MS", "0", 1);
+    std::cout << std::fixed << std::setprecision(2);
+
+    std::mutex notificationsMutex;
+    std::set<std::pair<long, intptr_t>> documentReady;
+    DeviceManager manager;
+    manager.setPasspr40LibName(argc > 1 ? argv[1] : STUB_PASSPR40_PATH);
+    manager.setNotificationCallback([&](long device, intptr_t code, intptr_t value) {
+        if (code == RPRM_Notification_DocumentReady) {
+            std::lock_guard<std::mutex> lock(notificationsMutex);
+            documentReady.insert(std::make_pair(device, value));
+        }
+    });
+
+    auto started = std::chrono::steady_clock::now();
+    size_t opened = manager.open();
+    auto openTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "opened " << opened << " devices in " << openTime << " ms" << std::endl;
+    check(opened == devices, "opens every device");
+    if (opened != devices) {
+        return 1;
+    }
+
+    started = std::chrono::steady_clock::now();
+    bool completed = true;
+    for (auto &future : manager.processAll(processMode)) {
+        completed = future.get().code == RPRM_Error_NoError && completed;
+    }
+    auto scanTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    std::cout << devices << " scans of " << processMs << " ms each took " << scanTime << " ms" << std::endl;
+    check(completed, "completes a scan on every device");
+
+    bool routed = true;
+    for (long device : manager.devices()) {
+        routed = documentReady.count(std::make_pair(device, static_cast<intptr_t>(device + 1))) && routed;
+    }
+    check(routed && documentReady.size() == devices, "routes every notification to the device it came from");
+
+    ResultSet &first = manager.reader(0)->Results();
+    std::vector<size_t> graphics = first.select(ResultSet::Graphic);
+    ResultView view = graphics.empty() ? ResultView() : first.fetch(graphics[0]);
+    manager.process(1, processMode).wait();
+    check(view.valid() && view.size() > 0 && manager.reader(1)->Results().size() == first.size(),
+          "keeps results per device");
+
+    manager.close();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,239 @@
+#include "httpsink.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+uint64_t nextRandom(uint64_t &state) {
+    // xorshift64*, plenty for latency jitter and error injection.
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+}
+
+std::string lowercase(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return std::tolower(c); });
+    return value;
+}
+
+bool sendAll(int fd, const char *data, size_t size) {
+    while (size) {
+        ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+}
+
+HttpSink::HttpSink() :
+    HttpSink(Options())
+{
+}
+
+HttpSink::HttpSink(Options o) :
+    options(o),
+    running(false),
+    requests(0),
+    errors(0),
+    connections(0),
+    bytes(0)
+{
+}
+
+HttpSink::~HttpSink() {
+    stop();
+}
+
+bool HttpSink::start() {
+    listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        std::cerr << "socket() failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(options.port);
+    if (::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(listenFd, 128) != 0) {
+        std::cerr << "bind()/listen() failed: " << strerror(errno) << std::endl;
+        ::close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    socklen_t length = sizeof(addr);
+    getsockname(listenFd, reinterpret_cast<sockaddr *>(&addr), &length);
+    boundPort = ntohs(addr.sin_port);
+
+    running = true;
+    for (unsigned i = 0; i < std::max(1u, options.threads); ++i) {
+        workers.emplace_back(&HttpSink::worker, this, i);
+    }
+    return true;
+}
+
+void HttpSink::stop() {
+    if (!running) {
+        return;
+    }
+
+    running = false;
+    for (auto &thread : workers) {
+        thread.join();
+    }
+    workers.clear();
+
+    ::close(listenFd);
+    listenFd = -1;
+}
+
+std::string HttpSink::url() const {
+    return "http://127.0.0.1:" + std::to_string(boundPort) + "/";
+}
+
+HttpSink::Stats HttpSink::stats() const {
+    Stats s;
+    s.requests = requests;
+    s.errors = errors;
+    s.connections = connections;
+    s.bytes = bytes;
+    return s;
+}
+
+void HttpSink::worker(unsigned index) {
+    uint64_t random = 0x9E3779B97F4A7C15ULL * (index + 1);
+
+    while (running) {
+        pollfd pfd{ listenFd, POLLIN, 0 };
+        if (::poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd < 0) {
+            // Another worker won the race for this connection.
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        ++connections;
+        serve(fd, random);
+        ::close(fd);
+    }
+}
+
+void HttpSink::serve(int fd, uint64_t &random) {
+    std::string buffer;
+    char chunk[64 * 1024];
+
+    auto fill = [&]() {
+        while (running) {
+            pollfd pfd{ fd, POLLIN, 0 };
+            int ready = ::poll(&pfd, 1, 100);
+            if (ready == 0) {
+                continue;
+            }
+            if (ready < 0 && errno == EINTR) {
+                continue;
+            }
+            if (ready < 0) {
+                return false;
+            }
+
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+            return true;
+        }
+        return false;
+    };
+
+    while (running) {
+        size_t headerEnd;
+        while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+            if (!fill()) {
+                return;
+            }
+        }
+
+        std::string head = lowercase(buffer.substr(0, headerEnd));
+        buffer.erase(0, headerEnd + 4);
+
+        size_t contentLength = 0;
+        size_t pos = head.find("\r\ncontent-length:");
+        if (pos != std::string::npos) {
+            contentLength = std::stoul(head.substr(pos + 17));
+        }
+        bool keepAlive = head.find("\r\nconnection: close") == std::string::npos;
+
+        if (head.find("\r\nexpect: 100-continue") != std::string::npos) {
+            static const char proceed[] = "HTTP/1.1 100 Continue\r\n\r\n";
+            if (!sendAll(fd, proceed, sizeof(proceed) - 1)) {
+                return;
+            }
+        }
+
+        // Bodies are only counted, never stored.
+        size_t remaining = contentLength;
+        while (remaining) {
+            if (buffer.empty() && !fill()) {
+                return;
+            }
+            size_t take = std::min(remaining, buffer.size());
+            buffer.erase(0, take);
+            remaining -= take;
+        }
+
+        auto delay = options.latency;
+        if (options.jitter.count() > 0) {
+            delay += std::chrono::microseconds(nextRandom(random) % static_cast<uint64_t>(options.jitter.count()));
+        }
+        if (delay.count() > 0) {
+            std::this_thread::sleep_for(delay);
+        }
+
+        bool fail = options.errorRate > 0.0
+            && (nextRandom(random) >> 11) * (1.0 / 9007199254740992.0) < options.errorRate;
+
+        ++requests;
+        bytes += contentLength;
+        if (fail) {
+            ++errors;
+        }
+
+        const std::string response = fail
+            ? "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n"
+            : "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nAccept-Encoding: gzip, zstd\r\nContent-Length: 0\r\n\r\n";
+        if (!sendAll(fd, response.data(), response.size()) || !keepAlive) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef HTTPSINK_H
+#define HTTPSINK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal local HTTP/1.1 endpoint that swallows POST bodies. Each worker thread serves
+// one keep-alive connection at a time, so `threads` bounds the concurrent connections.
+// Responses advertise gzip and zstd request bodies, so compression can be measured.
+class HttpSink {
+public:
+    struct Options {
+        unsigned threads = 8;
+        std::chrono::microseconds latency{ 0 };  // added before every response
+        std::chrono::microseconds jitter{ 0 };   // uniformly added on top of latency
+        double errorRate = 0.0;                  // share of requests answered with 503
+        uint16_t port = 0;                       // 0 picks a free port
+    };
+
+    struct Stats {
+        unsigned long requests = 0;
+        unsigned long errors = 0;
+        unsigned long connections = 0;
+        unsigned long long bytes = 0;
+    };
+
+private:
+    Options options;
+    int listenFd = -1;
+    uint16_t boundPort = 0;
+    std::atomic<bool> running;
+    std::vector<std::thread> workers;
+
+    std::atomic<unsigned long> requests;
+    std::atomic<unsigned long> errors;
+    std::atomic<unsigned long> connections;
+    std::atomic<unsigned long long> bytes;
+
+    void worker(unsigned);
+    void serve(int, uint64_t &);
+public:
+    HttpSink();
+    explicit HttpSink(Options);
+    ~HttpSink();
+
+    bool start();
+    void stop();
+
+    uint16_t port() const { return boundPort; }
+    std::string url() const;
+    Stats stats() const;
+};
+
+#endif
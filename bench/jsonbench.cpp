@@ -0,0 +1,484 @@
+#include "benchutil.h"
+#include "syntheticscan.h"
+#include "jsonextractor.h"
+#include "jsonfieldindex.h"
+#include "jsoncbor.h"
+#include "jsonpath.h"
+#include "jsonstructural.h"
+#ifdef HAVE_JSON_GLIB
+#include "jsonreader.h"
+#endif
+
+#include <atomic>
+#include <clocale>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+
+// Every heap allocation of the process is counted, see runAllocations().
+std::atomic<unsigned long> heapAllocations{ 0 };
+
+void *operator new(size_t size) {
+    ++heapAllocations;
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// Out of line, so that GCC does not pair the free() with an inlined operator new.
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+enum Kind {
+    Lexical,
+    DocType,
+    Authenticity
+};
+
+struct Document {
+    std::string name;
+    std::string json;
+    Kind kind;
+};
+
+void report(const std::string &what, const Document &doc, const Bench::Measurement &m) {
+    std::cout << std::left << std::setw(12) << what
+              << std::setw(22) << doc.name
+              << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << m.nanosPerOp / 1000.0 << " us"
+              << std::setw(10) << m.megabytesPerSecond(doc.json.size()) << " MB/s" << std::endl;
+}
+
+const char *extractorPath(const Document &doc) {
+    switch (doc.kind) {
+    case Lexical: return "ListVerifiedFields.pFieldMaps[wFieldType=165].Field_Visual";
+    case DocType: return "OneCandidate.FDSIDList.dType";
+    default: return "AuthenticityCheckList.List[Type=131072].Result";
+    }
+}
+
+void runExtractor(const Document &doc) {
+    Json::Extractor extractor;
+    int index = extractor.add(extractorPath(doc));
+
+    auto m = Bench::measure([&]() {
+        extractor.run(doc.json);
+        Bench::keep(extractor.value(index));
+    });
+    report("extractor", doc, m);
+    std::cout << "            value=\"" << extractor.value(index).text << "\" scanned "
+              << extractor.scanned() << "/" << doc.json.size() << " bytes" << std::endl;
+}
+
+// Index build alone per implementation, then extraction on top of the index. The
+// indexed time includes building the index.
+void runStructural(const Document &doc) {
+    Json::StructuralIndex structure;
+    for (auto implementation : { Json::StructuralIndex::Scalar, Json::StructuralIndex::Sse42, Json::StructuralIndex::Avx2 }) {
+        if (!Json::StructuralIndex::isSupported(implementation)) {
+            continue;
+        }
+        auto m = Bench::measure([&]() {
+            structure.build(doc.json, implementation);
+            Bench::keep(structure.size());
+        });
+        report(std::string("idx ") + Json::StructuralIndex::name(implementation), doc, m);
+    }
+
+    Json::Extractor plain, indexed;
+    int index = plain.add(extractorPath(doc));
+    indexed.add(extractorPath(doc));
+    plain.run(doc.json);
+
+    auto m = Bench::measure([&]() {
+        structure.build(doc.json);
+        indexed.run(doc.json, &structure);
+        Bench::keep(indexed.value(index));
+    });
+    report("indexed", doc, m);
+    if (indexed.value(index).text != plain.value(index).text) {
+        std::cout << "            mismatch with the plain extractor" << std::endl;
+    }
+}
+
+void runPath(const Document &doc) {
+    using DocType = Json::path<Json::Keys::OneCandidate, Json::Keys::FDSIDList, Json::Keys::dType>;
+
+    Json::Span span;
+    auto m = Bench::measure([&]() {
+        DocType::find(doc.json.data(), doc.json.size(), span);
+        Bench::keep(span);
+    });
+    report("path<>", doc, m);
+}
+
+// Field types a consumer typically reads per scan: serial, names, dates, nationality, MRZ.
+const std::vector<int> scanFields = { 165, 8, 9, 25, 26, 5, 3, 11, 1, 2, 51, 7 };
+
+void runRepeatedLookups(const Document &doc) {
+    Json::FieldIndex index;
+    auto indexed = Bench::measure([&]() {
+        index.build(doc.json);
+        for (int fieldType : scanFields) {
+            Bench::keep(index.value(fieldType));
+        }
+    });
+    report("index x12", doc, indexed);
+
+    Json::StructuralIndex structure;
+    Json::FieldIndex structured;
+    auto withStructure = Bench::measure([&]() {
+        structure.build(doc.json);
+        structured.build(doc.json, &structure);
+        for (int fieldType : scanFields) {
+            Bench::keep(structured.value(fieldType));
+        }
+    });
+    report("idx+fi x12", doc, withStructure);
+
+    Json::Extractor extractor;
+    for (int fieldType : scanFields) {
+        extractor.add("ListVerifiedFields.pFieldMaps[wFieldType=" + std::to_string(fieldType) + "].Field_Visual");
+    }
+    auto extracted = Bench::measure([&]() {
+        extractor.run(doc.json);
+        Bench::keep(extractor.value(0));
+    });
+    report("extract x12", doc, extracted);
+
+    for (size_t i = 0; i < scanFields.size(); ++i) {
+        if (index.value(scanFields[i]) != extractor.value(static_cast<int>(i)).text
+            || structured.value(scanFields[i]) != index.value(scanFields[i])) {
+            std::cout << "            mismatch for field type " << scanFields[i] << std::endl;
+        }
+    }
+}
+
+// Heap allocations per call of `op` once warmed up.
+template<typename F>
+double allocationsPerScan(F &&op) {
+    const unsigned scans = 100;
+    op();
+    unsigned long before = heapAllocations;
+    for (unsigned i = 0; i < scans; ++i) {
+        op();
+    }
+    return static_cast<double>(heapAllocations - before) / scans;
+}
+
+void reportAllocations(const std::string &what, const Document &doc, double allocations) {
+    std::cout << std::left << std::setw(12) << what
+              << std::setw(22) << doc.name
+              << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << allocations << " allocs/scan" << std::endl;
+}
+
+#ifdef HAVE_JSON_GLIB
+// Reads a few values the way a consumer of one scan would.
+template<typename ReaderT>
+void readScan(const Document &doc, const ReaderT &reader) {
+    using namespace Json::Keys;
+    switch (doc.kind) {
+    case Lexical:
+        Bench::keep(reader.template get<Json::path<ListVerifiedFields, Count>, long>());
+        break;
+    case DocType:
+        Bench::keep(reader.template get<Json::path<OneCandidate, FDSIDList, dType>, long>());
+        Bench::keep(reader.template view<Json::path<OneCandidate, DocumentName>>());
+        Bench::keep(reader.template view<Json::path<OneCandidate, FDSIDList, ICAOCode>>());
+        break;
+    default:
+        Bench::keep(reader.template get<Json::path<AuthenticityCheckList, Result>, long>());
+        break;
+    }
+}
+#endif
+
+// Encoded size and throughput, both relative to the JSON text. Decoding the CBOR and
+// encoding the result again must give the same bytes.
+void runCbor(const Document &doc) {
+    Json::Cbor cbor;
+    std::vector<uint8_t> packed;
+    std::string text;
+    auto encoded = Bench::measure([&]() {
+        cbor.encode(doc.json, packed);
+        Bench::keep(packed);
+    });
+    auto decoded = Bench::measure([&]() {
+        cbor.decode(packed, text);
+        Bench::keep(text);
+    });
+    report("cbor enc", doc, encoded);
+    report("cbor dec", doc, decoded);
+
+    std::vector<uint8_t> again;
+    bool same = cbor.encode(text, again) && again == packed;
+    std::cout << "            " << doc.json.size() << " -> " << packed.size() << " bytes ("
+              << std::setprecision(1) << 100.0 * packed.size() / doc.json.size() << "%)"
+              << (same ? "" : ", round trip differs") << std::endl;
+}
+
+// The application runs with the user's locale. Under a comma-decimal LC_NUMERIC, taken
+// from the environment or the first one installed, fractions must survive a CBOR round
+// trip and read back through the extractor. Skipped when no such locale exists.
+bool runNumericLocale() {
+    const std::string json = R"({"a":1.5,"b":[-0.25,3.14159,1e-07,100.0],"c":0.1})";
+
+    const char *chosen = nullptr;
+    for (const char *name : { "", "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8", "ru_RU.UTF-8", "ru_RU.utf8" }) {
+        if (std::setlocale(LC_NUMERIC, name) && std::string(std::localeconv()->decimal_point) != ".") {
+            chosen = name;
+            break;
+        }
+    }
+    if (!chosen) {
+        std::setlocale(LC_NUMERIC, "C");
+        std::cout << "skipped, no comma-decimal locale installed" << std::endl;
+        return true;
+    }
+    std::string localeName = std::setlocale(LC_NUMERIC, nullptr);
+
+    Json::Cbor cbor;
+    std::vector<uint8_t> packed;
+    std::string text;
+    bool cborOk = cbor.encode(json, packed) && cbor.decode(packed, text) && text == json;
+
+    Json::Extractor extractor;
+    int a = extractor.add("a");
+    int c = extractor.add("c");
+    bool extractorOk = extractor.run(json) && extractor.value(a).asDouble() == 1.5 && extractor.value(c).asDouble() == 0.1;
+
+    std::setlocale(LC_NUMERIC, "C");
+    std::cout << localeName << ": cbor " << (cborOk ? "ok" : "FAILED (" + text + ")")
+              << ", extractor " << (extractorOk ? "ok" : "FAILED") << std::endl;
+    return cborOk && extractorOk;
+}
+
+// Returns false when a reader meant to be allocation free allocated in the steady state.
+bool runAllocations(const Document &doc) {
+    double steady = 0.0;
+#ifdef HAVE_JSON_GLIB
+    Json::Arena arena;
+    double borrowed = allocationsPerScan([&]() {
+        arena.reset();
+        Json::Reader reader(doc.json, arena);
+        readScan(doc, reader);
+    });
+    reportAllocations("borrowed", doc, borrowed);
+    steady += borrowed;
+
+    reportAllocations("copied", doc, allocationsPerScan([&]() {
+        Json::Reader reader{ std::string(doc.json) };
+        readScan(doc, reader);
+    }));
+#endif
+
+    Json::Extractor extractor;
+    int index = extractor.add(extractorPath(doc));
+    double extracted = allocationsPerScan([&]() {
+        extractor.run(doc.json);
+        Bench::keep(extractor.value(index));
+    });
+    reportAllocations("extractor", doc, extracted);
+    steady += extracted;
+
+    if (doc.kind == Lexical) {
+        Json::FieldIndex fields;
+        double indexed = allocationsPerScan([&]() {
+            fields.build(doc.json);
+            for (int fieldType : scanFields) {
+                Bench::keep(fields.lookup(fieldType));
+            }
+        });
+        reportAllocations("index", doc, indexed);
+        steady += indexed;
+    }
+    return steady == 0.0;
+}
+
+#ifdef HAVE_JSON_GLIB
+// The fields MainWindow reads from every scan.
+struct ScanRecord {
+    std::string serial;
+    std::string surname;
+    std::string givenNames;
+    std::string birthDate;
+    std::string expiryDate;
+    std::string nationality;
+    long mrzValidity = -1;
+};
+
+const std::vector<std::pair<int, const char *>> recordFields = {
+    { 165, "Field_Visual" }, { 8, "Field_Visual" }, { 9, "Field_Visual" }, { 5, "Field_Visual" },
+    { 3, "Field_Visual" }, { 11, "Field_Visual" }, { 51, "Validity" }
+};
+
+void runSchema(const Document &doc) {
+    Json::Schema<ScanRecord> schema;
+    schema.add(165, &ScanRecord::serial)
+        .add(8, &ScanRecord::surname)
+        .add(9, &ScanRecord::givenNames)
+        .add(5, &ScanRecord::birthDate)
+        .add(3, &ScanRecord::expiryDate)
+        .add(11, &ScanRecord::nationality)
+        .add(51, &ScanRecord::mrzValidity, "Validity");
+
+    Json::Arena arena;
+    ScanRecord record;
+    auto extracted = Bench::measure([&]() {
+        arena.reset();
+        record = ScanRecord();
+        Json::Reader reader(doc.json, arena);
+        reader.extract(schema, record);
+        Bench::keep(record);
+    });
+    report("extract()", doc, extracted);
+
+    // One fetch()/searchElement() per field, the way fields used to be read.
+    std::vector<Json::Reader::MemberValue> values(recordFields.size());
+    auto sequential = Bench::measure([&]() {
+        Json::Reader reader(doc.json);
+        for (size_t i = 0; i < recordFields.size(); ++i) {
+            reader.fetch("ListVerifiedFields", "pFieldMaps");
+            values[i] = reader.searchElement("wFieldType", recordFields[i].second, recordFields[i].first);
+        }
+        Bench::keep(values);
+    });
+    report("glib x7", doc, sequential);
+
+    Json::FieldIndex fields;
+    std::vector<std::string> indexed(recordFields.size());
+    auto lookedUp = Bench::measure([&]() {
+        fields.build(doc.json);
+        for (size_t i = 0; i < recordFields.size(); ++i) {
+            indexed[i] = fields.value(recordFields[i].first, recordFields[i].second);
+        }
+        Bench::keep(indexed);
+    });
+    report("index x7", doc, lookedUp);
+
+    std::vector<std::string> fromRecord = { record.serial, record.surname, record.givenNames, record.birthDate,
+        record.expiryDate, record.nationality, record.mrzValidity < 0 ? "" : std::to_string(record.mrzValidity) };
+    if (fromRecord != indexed) {
+        std::cout << "            extract() disagrees with the field index" << std::endl;
+    }
+}
+
+void runJsonGlibLookups(const Document &doc) {
+    auto m = Bench::measure([&]() {
+        Json::Reader reader(doc.json);
+        reader.fetch("ListVerifiedFields", "pFieldMaps");
+        for (int fieldType : scanFields) {
+            Bench::keep(reader.searchElement("wFieldType", "Field_Visual", fieldType));
+        }
+    });
+    report("glib x12", doc, m);
+}
+
+void runJsonGlib(const Document &doc) {
+    // Same calls MainWindow used to make, a full DOM per document.
+    auto m = Bench::measure([&]() {
+        Json::Reader reader(doc.json);
+        Json::Reader::MemberValue v;
+        if (doc.kind == Lexical) {
+            reader.fetch("ListVerifiedFields", "pFieldMaps");
+            v = reader.searchElement("wFieldType", "Field_Visual", 165);
+        } else if (doc.kind == DocType) {
+            reader.fetch("OneCandidate", "FDSIDList", "dType");
+            v = reader.getValue(Json::Reader::MemberType::Int);
+        } else {
+            reader.fetch("AuthenticityCheckList", "Result");
+            v = reader.getValue(Json::Reader::MemberType::Int);
+        }
+        Bench::keep(v);
+    });
+    report("json-glib", doc, m);
+}
+#endif
+
+}
+
+// Usage: JsonBench [--lex FILE]... [--doctype FILE]... [--auth FILE]...
+// Files are OCRLexicalAnalyze / ChosenDocumentTypeCandidate / Authenticity results, for
+// example the tmp/Lex_0.json and tmp/DocType_0.json written with artifacts/save enabled.
+int main(int argc, char **argv) {
+    std::vector<Document> documents;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        Kind kind = option == "--lex" ? Lexical : option == "--auth" ? Authenticity : DocType;
+        documents.push_back(Document{ argv[i + 1], Bench::readFile(argv[i + 1]), kind });
+    }
+    if (documents.empty()) {
+        for (size_t kb : { 16, 64, 256, 1024 }) {
+            documents.push_back(Document{ "lex " + std::to_string(kb) + "K", Synthetic::lexicalJson(kb * 1024), Lexical });
+        }
+        documents.push_back(Document{ "doctype", Synthetic::docTypeJson(), DocType });
+        for (size_t kb : { 256, 4096 }) {
+            documents.push_back(Document{ "auth " + std::to_string(kb) + "K", Synthetic::authenticityJson(kb * 1024), Authenticity });
+        }
+    }
+
+    std::cout << "structural index: " << Json::StructuralIndex::name(Json::StructuralIndex::best()) << std::endl;
+    for (auto &doc : documents) {
+#ifdef HAVE_JSON_GLIB
+        runJsonGlib(doc);
+#endif
+        runExtractor(doc);
+        runStructural(doc);
+        if (doc.kind == DocType) {
+            runPath(doc);
+        }
+    }
+
+    std::cout << "\nCBOR:" << std::endl;
+    for (auto &doc : documents) {
+        runCbor(doc);
+    }
+
+    std::cout << "\nnumbers under the user's locale:" << std::endl;
+    bool localeSafe = runNumericLocale();
+
+    bool zeroAllocations = true;
+    std::cout << "\nheap allocations in the steady state:" << std::endl;
+    for (auto &doc : documents) {
+        zeroAllocations = runAllocations(doc) && zeroAllocations;
+    }
+
+    std::cout << "\n" << scanFields.size() << " fields per scan:" << std::endl;
+    for (auto &doc : documents) {
+        if (doc.kind != Lexical) {
+            continue;
+        }
+#ifdef HAVE_JSON_GLIB
+        runJsonGlibLookups(doc);
+#endif
+        runRepeatedLookups(doc);
+    }
+
+#ifdef HAVE_JSON_GLIB
+    std::cout << "\none record per scan:" << std::endl;
+    for (auto &doc : documents) {
+        if (doc.kind == Lexical) {
+            runSchema(doc);
+        }
+    }
+#endif
+
+    if (!zeroAllocations) {
+        std::cout << "\nJSON handling allocated in the steady state" << std::endl;
+    }
+    if (!localeSafe) {
+        std::cout << "\nJSON numbers depend on the locale" << std::endl;
+    }
+    return zeroAllocations && localeSafe ? 0 : 1;
+}
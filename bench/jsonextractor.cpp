@@ -0,0 +1,250 @@
+#include "jsonextractor.h"
+
+#include <cstdlib>
+
+namespace Json {
+
+namespace {
+
+const unsigned maxDepth = 512;
+
+}
+
+int Extractor::Value::asInt() const {
+    if (type == Bool) {
+        return asBool() ? 1 : 0;
+    }
+    return static_cast<int>(std::strtol(text.c_str(), nullptr, 10));
+}
+
+double Extractor::Value::asDouble() const {
+    return Scanner::toDouble(text.data(), text.size());
+}
+
+bool Extractor::Value::asBool() const {
+    return text == "true";
+}
+
+int Extractor::add(const std::string &path) {
+    Target target;
+    target.path = path;
+
+    bool selected = false;
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t dot = path.find('.', start);
+        if (dot == std::string::npos) {
+            dot = path.size();
+        }
+        std::string segment = path.substr(start, dot - start);
+        start = dot + 1;
+
+        Step step;
+        size_t open = segment.find('[');
+        if (open != std::string::npos) {
+            size_t assign = segment.find('=', open);
+            if (selected || segment.back() != ']' || assign == std::string::npos) {
+                qDebug() << "Invalid JSON path:" << path.c_str();
+                return -1;
+            }
+            step.select = true;
+            step.key = segment.substr(open + 1, assign - open - 1);
+            step.equals = segment.substr(assign + 1, segment.size() - assign - 2);
+            segment.resize(open);
+            selected = true;
+        }
+        if (segment.empty()) {
+            qDebug() << "Invalid JSON path:" << path.c_str();
+            return -1;
+        }
+        step.name = segment;
+        target.steps.push_back(step);
+    }
+
+    targets.push_back(target);
+    return static_cast<int>(targets.size() - 1);
+}
+
+const Extractor::Value &Extractor::value(int index) const {
+    static const Value missing;
+    if (index < 0 || static_cast<size_t>(index) >= targets.size()) {
+        return missing;
+    }
+    return targets[index].value;
+}
+
+bool Extractor::run(const char *data, size_t size, const StructuralIndex *index) {
+    in.reset(data, size, index);
+    remaining = 0;
+
+    std::vector<Cursor> &root = scratch(0).children;
+    root.clear();
+    for (unsigned i = 0; i < targets.size(); ++i) {
+        // Keeps the capacity of the string for the next run.
+        targets[i].value.type = Missing;
+        targets[i].value.text.clear();
+        targets[i].pending = Span();
+        targets[i].matched = false;
+        root.push_back(Cursor{ i, 0, false });
+        ++remaining;
+    }
+    if (root.empty()) {
+        return true;
+    }
+
+    Span span;
+    parseValue(root, 0, span);
+    return !in.failed();
+}
+
+Extractor::Level &Extractor::scratch(unsigned depth) {
+    while (levels.size() <= depth) {
+        levels.emplace_back();
+    }
+    return levels[depth];
+}
+
+// Every parse function returns false to unwind, either on malformed input (the scanner
+// has failed) or because the last target has just been found.
+bool Extractor::parseValue(const std::vector<Cursor> &cursors, unsigned depth, Span &span) {
+    char c = in.peek();
+    if (!c) {
+        return in.fail("unexpected end of input");
+    }
+    if (depth > maxDepth) {
+        return in.fail("nesting is too deep");
+    }
+
+    // Containers no cursor can descend into are skipped without looking at their members.
+    bool descend = false;
+    for (auto &cursor : cursors) {
+        const Target &target = targets[cursor.target];
+        if (c == '[') {
+            descend = descend || (cursor.step && !cursor.element && target.steps[cursor.step - 1].select);
+        } else {
+            descend = descend || cursor.step < target.steps.size() || cursor.element;
+        }
+    }
+
+    size_t start = in.offset();
+    bool ok;
+    if (!descend || (c != '{' && c != '[')) {
+        ok = in.skip(span);
+    } else if (c == '{') {
+        const char *begin = in.position();
+        ok = parseObject(cursors, depth);
+        span = Span{ Object, begin, in.offset() - start, false };
+    } else {
+        const char *begin = in.position();
+        ok = parseArray(cursors, depth);
+        span = Span{ Array, begin, in.offset() - start, false };
+    }
+    if (!ok) {
+        return false;
+    }
+
+    for (auto &cursor : cursors) {
+        Target &target = targets[cursor.target];
+        bool selecting = cursor.step && !cursor.element && target.steps[cursor.step - 1].select;
+        if (cursor.step == target.steps.size() && !selecting && !target.value.found()) {
+            if (cursor.element) {
+                // Kept until the element is known to match its selector.
+                if (target.pending.type == Missing) {
+                    target.pending = span;
+                }
+            } else {
+                capture(target, span);
+                if (!remaining) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool Extractor::parseObject(const std::vector<Cursor> &cursors, unsigned depth) {
+    in.enter('{');
+
+    Level &level = scratch(depth + 1);
+    std::vector<Cursor> &children = level.children;
+    std::vector<Cursor> &checks = level.checks;
+    bool first = true;
+    Span key;
+    while (in.nextMember(first, key)) {
+        children.clear();
+        checks.clear();
+        for (auto &cursor : cursors) {
+            Target &target = targets[cursor.target];
+            if (target.value.found()) {
+                continue;
+            }
+
+            // This object is an element of a selected array, look for the selector key.
+            const Step *selector = cursor.element && cursor.step ? &target.steps[cursor.step - 1] : nullptr;
+            if (selector && selector->select && Scanner::equals(key, selector->key)) {
+                checks.push_back(cursor);
+            }
+
+            if (cursor.step < target.steps.size() && Scanner::equals(key, target.steps[cursor.step].name)) {
+                children.push_back(Cursor{ cursor.target, cursor.step + 1, cursor.element });
+            }
+        }
+
+        Span member;
+        if (!parseValue(children, depth + 1, member)) {
+            return false;
+        }
+        for (auto &check : checks) {
+            targets[check.target].matched = member.type != Object && member.type != Array
+                && Scanner::equals(member, targets[check.target].steps[check.step - 1].equals);
+        }
+    }
+    return !in.failed();
+}
+
+bool Extractor::parseArray(const std::vector<Cursor> &cursors, unsigned depth) {
+    in.enter('[');
+
+    // Only a path segment with a selector descends into array elements.
+    std::vector<Cursor> &elements = scratch(depth + 1).children;
+    bool first = true;
+    while (in.nextElement(first)) {
+        elements.clear();
+        for (auto &cursor : cursors) {
+            Target &target = targets[cursor.target];
+            if (!target.value.found() && cursor.step && !cursor.element && target.steps[cursor.step - 1].select) {
+                target.pending = Span();
+                target.matched = false;
+                elements.push_back(Cursor{ cursor.target, cursor.step, true });
+            }
+        }
+
+        Span element;
+        if (!parseValue(elements, depth + 1, element)) {
+            return false;
+        }
+        for (auto &cursor : elements) {
+            Target &target = targets[cursor.target];
+            if (target.matched && target.pending.type != Missing) {
+                capture(target, target.pending);
+                if (!remaining) {
+                    return false;
+                }
+            }
+        }
+    }
+    return !in.failed();
+}
+
+void Extractor::capture(Target &target, const Span &span) {
+    target.value.type = span.type;
+    if (span.type == String && span.escaped) {
+        Scanner::unescape(span, target.value.text);
+    } else {
+        target.value.text.assign(span.begin, span.size);
+    }
+    --remaining;
+}
+
+}
@@ -0,0 +1,94 @@
+#ifndef JSONEXTRACTOR_H
+#define JSONEXTRACTOR_H
+
+#include "jsonscanner.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace Json {
+
+// Pulls a handful of values out of a JSON text in one forward pass, without building
+// a document. Subtrees no target goes through are skipped, and the pass stops as soon
+// as every target has been found.
+//
+// A path is a dot-separated list of member names. A segment may select an array
+// element by one of its members, "pFieldMaps[wFieldType=165]" takes the first element
+// whose wFieldType is 165. At most one such selector is allowed per path.
+class Extractor {
+public:
+    struct Value {
+        ValueType type = Missing;
+        // Unescaped contents for strings, the raw JSON text for everything else.
+        std::string text;
+
+        bool found() const { return type != Missing; }
+        int asInt() const;
+        double asDouble() const;
+        bool asBool() const;
+        const std::string &asString() const { return text; }
+    };
+
+private:
+    struct Step {
+        std::string name;
+        // Element selector applied to the array `name` refers to.
+        bool select = false;
+        std::string key;
+        std::string equals;
+    };
+
+    struct Target {
+        std::string path;
+        std::vector<Step> steps;
+        Value value;
+
+        Span pending;
+        bool matched = false;
+    };
+
+    // Position of one target inside the value being parsed. `step` counts the path
+    // segments already matched, `element` is set while inside a selected array element.
+    struct Cursor {
+        unsigned target;
+        unsigned step;
+        bool element;
+    };
+
+    // Cursors of the members or elements at one nesting depth, reused across runs so
+    // that a warmed up extractor does not allocate.
+    struct Level {
+        std::vector<Cursor> children;
+        std::vector<Cursor> checks;
+    };
+
+    std::vector<Target> targets;
+    unsigned remaining = 0;
+    // A deque keeps references to the levels valid while deeper ones are added.
+    std::deque<Level> levels;
+
+    Scanner in;
+
+    bool parseValue(const std::vector<Cursor> &, unsigned, Span &);
+    bool parseObject(const std::vector<Cursor> &, unsigned);
+    bool parseArray(const std::vector<Cursor> &, unsigned);
+    void capture(Target &, const Span &);
+    Level &scratch(unsigned);
+public:
+    // Returns the index of the target, or -1 when the path can not be parsed.
+    int add(const std::string &);
+    size_t count() const { return targets.size(); }
+
+    // Clears the values of a previous run, targets are kept.
+    // An optional structural index of the same text speeds up skipping large subtrees.
+    bool run(const char *, size_t, const StructuralIndex * = nullptr);
+    bool run(const std::string &data, const StructuralIndex *index = nullptr) { return run(data.data(), data.size(), index); }
+
+    const Value &value(int) const;
+    // Bytes consumed by the last run, less than the input size when it stopped early.
+    size_t scanned() const { return in.offset(); }
+};
+
+}
+
+#endif
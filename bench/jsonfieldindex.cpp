@@ -0,0 +1,185 @@
+#include "jsonfieldindex.h"
+
+namespace Json {
+
+namespace {
+
+const std::string listVerifiedFields = "ListVerifiedFields";
+const std::string pFieldMaps = "pFieldMaps";
+const std::string wFieldType = "wFieldType";
+
+inline uint32_t hashKey(int32_t key, unsigned shift) {
+    // Fibonacci hashing, field types are small consecutive integers.
+    return shift >= 32 ? 0 : (static_cast<uint32_t>(key) * 2654435769u) >> shift;
+}
+
+}
+
+std::string FieldIndex::Field::member(const std::string &name) const {
+    std::string result;
+    if (!data) {
+        return result;
+    }
+
+    Scanner in;
+    in.reset(data, size);
+    if (!in.enter('{')) {
+        return result;
+    }
+
+    bool first = true;
+    Span key, value;
+    while (in.nextMember(first, key)) {
+        if (!in.skip(value)) {
+            break;
+        }
+        if (Scanner::equals(key, name)) {
+            if (value.type == String && value.escaped) {
+                Scanner::unescape(value, result);
+            } else if (value.type != Null) {
+                result.assign(value.begin, value.size);
+            }
+            break;
+        }
+    }
+    return result;
+}
+
+bool FieldIndex::build(const char *data, size_t size, const StructuralIndex *index) {
+    text = data;
+    fields = 0;
+    elements.clear();
+    in.reset(data, size, index);
+
+    bool ok = indexElements();
+
+    size_t capacity = 16;
+    while (capacity < elements.size() * 2) {
+        capacity <<= 1;
+    }
+    shift = 32;
+    for (size_t c = capacity; c > 1; c >>= 1) {
+        --shift;
+    }
+    slots.assign(capacity, Slot{ emptyKey, 0, 0 });
+    for (auto &element : elements) {
+        insert(element);
+    }
+    return ok;
+}
+
+bool FieldIndex::indexElements() {
+    bool first = true;
+    Span key, value;
+
+    // Walk down to ListVerifiedFields.pFieldMaps, skipping everything else.
+    if (!in.enter('{')) {
+        return false;
+    }
+    bool found = false;
+    while (!found && in.nextMember(first, key)) {
+        found = Scanner::equals(key, listVerifiedFields);
+        if (!found && !in.skip(value)) {
+            return false;
+        }
+    }
+    if (!found || !in.enter('{')) {
+        return !in.failed();
+    }
+
+    first = true;
+    found = false;
+    while (!found && in.nextMember(first, key)) {
+        found = Scanner::equals(key, pFieldMaps);
+        if (!found && !in.skip(value)) {
+            return false;
+        }
+    }
+    if (!found || !in.enter('[')) {
+        return !in.failed();
+    }
+
+    first = true;
+    while (in.nextElement(first)) {
+        if (in.peek() != '{') {
+            if (!in.skip(value)) {
+                return false;
+            }
+            continue;
+        }
+
+        const char *start = in.position();
+        in.enter('{');
+        int32_t fieldType = emptyKey;
+        bool firstMember = true;
+        while (in.nextMember(firstMember, key)) {
+            if (!in.skip(value)) {
+                return false;
+            }
+            if (fieldType == emptyKey && value.type == Number && Scanner::equals(key, wFieldType)) {
+                fieldType = static_cast<int32_t>(Scanner::toLong(value));
+            }
+        }
+        if (in.failed()) {
+            return false;
+        }
+        if (fieldType != emptyKey) {
+            elements.push_back(Slot{ fieldType, static_cast<uint32_t>(start - text), static_cast<uint32_t>(in.position() - start) });
+        }
+    }
+    return !in.failed();
+}
+
+void FieldIndex::insert(const Slot &slot) {
+    size_t mask = slots.size() - 1;
+    for (size_t i = hashKey(slot.key, shift); ; i = (i + 1) & mask) {
+        if (slots[i].key == slot.key) {
+            return;
+        }
+        if (slots[i].key == emptyKey) {
+            slots[i] = slot;
+            ++fields;
+            return;
+        }
+    }
+}
+
+const FieldIndex::Slot *FieldIndex::find(int fieldType) const {
+    if (slots.empty() || fieldType == emptyKey) {
+        return nullptr;
+    }
+
+    size_t mask = slots.size() - 1;
+    for (size_t i = hashKey(fieldType, shift); ; i = (i + 1) & mask) {
+        if (slots[i].key == fieldType) {
+            return &slots[i];
+        }
+        if (slots[i].key == emptyKey) {
+            return nullptr;
+        }
+    }
+}
+
+FieldIndex::Field FieldIndex::lookup(int fieldType) const {
+    Field field;
+    if (const Slot *slot = find(fieldType)) {
+        field.data = text + slot->offset;
+        field.size = slot->size;
+    }
+    return field;
+}
+
+std::vector<FieldIndex::Field> FieldIndex::lookup(std::initializer_list<int> fieldTypes) const {
+    std::vector<Field> result;
+    result.reserve(fieldTypes.size());
+    for (int fieldType : fieldTypes) {
+        result.push_back(lookup(fieldType));
+    }
+    return result;
+}
+
+std::string FieldIndex::value(int fieldType, const std::string &member) const {
+    return lookup(fieldType).member(member);
+}
+
+}
@@ -0,0 +1,59 @@
+#ifndef JSONFIELDINDEX_H
+#define JSONFIELDINDEX_H
+
+#include "jsonscanner.h"
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace Json {
+
+// Maps wFieldType to its element of ListVerifiedFields.pFieldMaps in an OCRLexicalAnalyze
+// result. Built in one pass, then every lookup is a probe into a flat open-addressing
+// table. Fields point into the indexed text, which must outlive the index.
+class FieldIndex {
+public:
+    struct Field {
+        const char *data = nullptr;
+        size_t size = 0;
+
+        bool found() const { return data != nullptr; }
+        // Unescaped string or raw scalar of a member of the element, empty when missing.
+        std::string member(const std::string &) const;
+    };
+
+private:
+    struct Slot {
+        int32_t key;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    static const int32_t emptyKey = INT32_MIN;
+
+    const char *text = nullptr;
+    std::vector<Slot> slots;
+    std::vector<Slot> elements;
+    unsigned shift = 32;
+    size_t fields = 0;
+    Scanner in;
+
+    bool indexElements();
+    void insert(const Slot &);
+    const Slot *find(int) const;
+public:
+    // Returns false when the text is malformed, the fields seen up to the error stay indexed.
+    bool build(const char *, size_t, const StructuralIndex * = nullptr);
+    bool build(const std::string &data, const StructuralIndex *index = nullptr) { return build(data.data(), data.size(), index); }
+    size_t size() const { return fields; }
+
+    // The first element with that field type, when a type occurs more than once.
+    Field lookup(int) const;
+    std::vector<Field> lookup(std::initializer_list<int>) const;
+    std::string value(int, const std::string & = "Field_Visual") const;
+};
+
+}
+
+#endif
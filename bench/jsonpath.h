@@ -0,0 +1,114 @@
+#ifndef JSONPATH_H
+#define JSONPATH_H
+
+#include "jsonscanner.h"
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace Json {
+
+// A member name known at compile time. Matching compares the length and the first
+// eight bytes as one word before falling back to memcmp for longer names.
+struct Key {
+    const char *name;
+    size_t length;
+    uint64_t prefix;
+
+    static constexpr size_t lengthOf(const char *s) {
+        size_t n = 0;
+        while (s[n]) {
+            ++n;
+        }
+        return n;
+    }
+
+    static constexpr uint64_t prefixOf(const char *s, size_t n) {
+        uint64_t word = 0;
+        for (size_t i = 0; i < n && i < 8; ++i) {
+            word |= static_cast<uint64_t>(static_cast<unsigned char>(s[i])) << (8 * i);
+        }
+        return word;
+    }
+
+    constexpr Key(const char *s) :
+        name(s),
+        length(lengthOf(s)),
+        prefix(prefixOf(s, lengthOf(s)))
+    {
+    }
+
+    bool matches(const Span &key) const {
+        if (key.size != length || key.escaped) {
+            return key.escaped && Scanner::equals(key, std::string(name, length));
+        }
+        uint64_t word = 0;
+        std::memcpy(&word, key.begin, length < 8 ? length : 8);
+        return word == prefix && (length <= 8 || std::memcmp(key.begin + 8, name + 8, length - 8) == 0);
+    }
+};
+
+// Member path resolved at compile time, e.g.
+// path<Keys::OneCandidate, Keys::FDSIDList, Keys::dType>.
+// Each level is an unrolled matcher for its key, no path string is parsed at runtime.
+template<const char *...Names>
+struct path {
+    static constexpr size_t depth = sizeof...(Names);
+    static constexpr std::array<Key, depth> keys{ { Key(Names)... } };
+
+    static bool find(const char *data, size_t size, Span &out, const StructuralIndex *index = nullptr) {
+        Scanner in;
+        in.reset(data, size, index);
+        return descend<0>(in) && in.skip(out);
+    }
+
+    // Leaves `in` in front of the value at the path, for callers that walk into it.
+    static bool seek(Scanner &in) {
+        return descend<0>(in);
+    }
+
+private:
+    template<size_t Level>
+    static bool descend(Scanner &in) {
+        if constexpr (Level == depth) {
+            return true;
+        } else {
+            if (in.peek() != '{') {
+                return false;
+            }
+            in.enter('{');
+
+            bool first = true;
+            Span key;
+            while (in.nextMember(first, key)) {
+                if (keys[Level].matches(key)) {
+                    return descend<Level + 1>(in);
+                }
+                if (!in.skip(key)) {
+                    return false;
+                }
+            }
+            return false;
+        }
+    }
+};
+
+// Member names of SDK results used with path<>.
+namespace Keys {
+inline constexpr char OneCandidate[] = "OneCandidate";
+inline constexpr char FDSIDList[] = "FDSIDList";
+inline constexpr char dType[] = "dType";
+inline constexpr char dFormat[] = "dFormat";
+inline constexpr char ICAOCode[] = "ICAOCode";
+inline constexpr char DocumentName[] = "DocumentName";
+inline constexpr char ListVerifiedFields[] = "ListVerifiedFields";
+inline constexpr char pFieldMaps[] = "pFieldMaps";
+inline constexpr char Count[] = "Count";
+inline constexpr char wFieldType[] = "wFieldType";
+inline constexpr char AuthenticityCheckList[] = "AuthenticityCheckList";
+inline constexpr char Result[] = "Result";
+}
+
+}
+
+#endif
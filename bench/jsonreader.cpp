@@ -0,0 +1,205 @@
+#include "jsonreader.h"
+
+namespace Json {
+
+Reader::Reader(std::string data) :
+    owned(std::move(data)),
+    text(owned)
+{
+}
+
+Reader::Reader(std::string_view data, Arena &arena) :
+    text(data),
+    arena(&arena),
+    structure(&arena)
+{
+}
+
+JsonReader *Reader::document() {
+    if (parser) {
+        return reader;
+    }
+
+    parser = json_parser_new();
+    if (!json_parser_load_from_data(parser, text.data(), static_cast<gssize>(text.size()), &err)) {
+        qDebug() << "json_parser_load_from_data() failed:" << err->message;
+        return nullptr;
+    }
+
+    reader = json_reader_new(
+        json_parser_get_root(parser)
+    );
+    return reader;
+}
+
+const StructuralIndex *Reader::index() const {
+    if (text.size() < indexThreshold) {
+        return nullptr;
+    }
+    if (!indexed) {
+        indexed = true;
+        structure.build(text.data(), text.size());
+    }
+    return structure.covers(text.data(), text.size()) ? &structure : nullptr;
+}
+
+Arena &Reader::scratch() const {
+    if (!arena) {
+        ownArena.reset(new Arena(4096));
+        arena = ownArena.get();
+    }
+    return *arena;
+}
+
+std::string_view Reader::viewOf(const Span &span) const {
+    if (span.type == Json::Null || span.type == Json::Missing) {
+        return std::string_view();
+    }
+    if (span.type == Json::String && span.escaped) {
+        char *buffer = scratch().allocate<char>(span.size);
+        return std::string_view(buffer, Scanner::unescape(span, buffer));
+    }
+    return std::string_view(span.begin, span.size);
+}
+
+namespace {
+
+// Takes a member of a pFieldMaps element when a query of its field type asks for it.
+void take(const Span &key, const Span &value, long fieldType, const FieldQuery *queries, size_t count, Span *spans, size_t &remaining) {
+    for (size_t i = 0; i < count; ++i) {
+        if (queries[i].fieldType == fieldType && spans[i].type == Json::Missing && queries[i].member.matches(key)) {
+            spans[i] = value;
+            --remaining;
+        }
+    }
+}
+
+}
+
+bool Reader::findFields(const FieldQuery *queries, size_t count, Span *spans) const {
+    for (size_t i = 0; i < count; ++i) {
+        spans[i] = Span();
+    }
+
+    // Every element is walked member by member, a structural index does not pay off here.
+    Scanner in;
+    in.reset(text.data(), text.size());
+    if (!path<Keys::ListVerifiedFields, Keys::pFieldMaps>::seek(in) || !in.enter('[')) {
+        return !in.failed();
+    }
+
+    const Key fieldTypeKey(Keys::wFieldType);
+    size_t remaining = count;
+    bool first = true;
+    Span key, value;
+    while (remaining && in.nextElement(first)) {
+        if (in.peek() != '{') {
+            if (!in.skip(value)) {
+                return false;
+            }
+            continue;
+        }
+
+        // wFieldType normally comes before the values, which are then matched on the way.
+        // An element with a wanted member ahead of its type is read once more.
+        const char *start = in.position();
+        in.enter('{');
+        long fieldType = 0;
+        bool typed = false;
+        bool wanted = false;
+        bool before = false;
+        bool firstMember = true;
+        while (in.nextMember(firstMember, key)) {
+            if (!in.skip(value)) {
+                return false;
+            }
+            if (typed) {
+                if (wanted) {
+                    take(key, value, fieldType, queries, count, spans, remaining);
+                }
+            } else if (value.type == Json::Number && fieldTypeKey.matches(key)) {
+                fieldType = Scanner::toLong(value);
+                typed = true;
+                for (size_t i = 0; i < count && !wanted; ++i) {
+                    wanted = queries[i].fieldType == fieldType && spans[i].type == Json::Missing;
+                }
+            } else {
+                for (size_t i = 0; i < count && !before; ++i) {
+                    before = queries[i].member.matches(key);
+                }
+            }
+        }
+        if (in.failed()) {
+            return false;
+        }
+
+        if (wanted && before) {
+            Scanner element;
+            element.reset(start, static_cast<size_t>(in.position() - start));
+            element.enter('{');
+            firstMember = true;
+            while (element.nextMember(firstMember, key) && element.skip(value)) {
+                take(key, value, fieldType, queries, count, spans, remaining);
+            }
+        }
+    }
+    return !in.failed();
+}
+
+Reader::~Reader() {
+    if (err) {
+        g_error_free(err);
+    }
+
+    if (reader) {
+        end();
+        g_object_unref(reader);
+    }
+
+    if (parser) {
+        g_object_unref(parser);
+    }
+}
+
+Reader::MemberValue Reader::searchElement(std::string byKey, std::string member, int compare) {
+    Reader::MemberValue v;
+
+    int countElements = json_reader_count_elements(document());
+    for (int i = 0; i < countElements; i++) {
+        json_reader_read_element(reader, i);
+
+        fetch(byKey.c_str());
+        internalIt = 1;
+        v = getValue(Reader::MemberType::Int);
+
+        if (v.mvInt == compare) {
+            fetch(member.c_str());
+            internalIt = 1;
+            v = getValue(Reader::MemberType::String);
+
+            json_reader_end_element(reader);
+            return v;
+        }
+
+        json_reader_end_element(reader);
+    }
+
+    return v;
+}
+
+void Reader::end() {
+    if (!reader) {
+        return;
+    }
+
+    if (internalIt <= 0) {
+        internalIt = mainIt;
+    }
+
+    while (internalIt) {
+        json_reader_end_member(reader);
+        --mainIt, --internalIt;
+    }
+}
+
+}
@@ -0,0 +1,201 @@
+#ifndef JSONREADER_H
+#define JSONREADER_H
+
+#include "jsonarena.h"
+#include "jsonpath.h"
+#include "jsonschema.h"
+#include "jsonstructural.h"
+#include <json-glib/json-glib.h>
+#include <QDebug>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace Json {
+
+class Reader {
+
+private:
+    long mainIt = 0;
+    long internalIt = 0;
+
+    // `text` views `owned` or the caller's buffer.
+    std::string owned;
+    std::string_view text;
+
+    // Unescaped strings handed out by view<>(). A reader over its own copy of the text
+    // creates a private arena on first use.
+    mutable Arena *arena = nullptr;
+    mutable std::unique_ptr<Arena> ownArena;
+
+    // Large results are read through a structural index built on the first get<>().
+    static const size_t indexThreshold = 16 * 1024;
+    mutable StructuralIndex structure;
+    mutable bool indexed = false;
+
+    const StructuralIndex *index() const;
+    Arena &scratch() const;
+    std::string_view viewOf(const Span &) const;
+    bool findFields(const FieldQuery *, size_t, Span *) const;
+
+    // The json-glib document is only built for the fetch()/searchElement() API.
+    JsonParser *parser = nullptr;
+    JsonReader *reader = nullptr;
+
+    GError *err = nullptr;
+
+    JsonReader *document();
+
+    template<typename T>
+    static T convert(const Span &span, T otherwise) {
+        if constexpr (std::is_same<T, bool>::value) {
+            return span.type == Json::Bool ? span.begin[0] == 't' : otherwise;
+        } else if constexpr (std::is_integral<T>::value) {
+            return span.type == Json::Number ? static_cast<T>(Scanner::toLong(span)) : otherwise;
+        } else if constexpr (std::is_floating_point<T>::value) {
+            return span.type == Json::Number ? static_cast<T>(Scanner::toDouble(span)) : otherwise;
+        } else {
+            static_assert(std::is_same<T, std::string>::value, "get<> supports bool, integers, floating point and std::string");
+            std::string value;
+            if (span.type == Json::String && span.escaped) {
+                Scanner::unescape(span, value);
+            } else if (span.type != Json::Null) {
+                value.assign(span.begin, span.size);
+            }
+            return value;
+        }
+    }
+
+public:
+    enum MemberType {
+        Int,
+        Double,
+        String,
+        Bool
+    };
+
+    struct MemberValue {
+        int mvInt;
+        double mvDouble;
+        std::string mvString;
+        bool mvBool;
+    };
+
+    Reader(std::string);
+    // Borrows `data` without copying. The text must outlive the reader, and `arena` must
+    // not be reset while views returned by the reader are in use.
+    Reader(std::string_view data, Arena &arena);
+    Reader(const Reader &) = delete;
+    Reader &operator=(const Reader &) = delete;
+    ~Reader();
+
+    // Value at a compile-time path, read straight from the text without a document.
+    // `otherwise` is returned when the path is missing or holds another type.
+    template<typename Path, typename T>
+    T get(T otherwise = T()) const {
+        Span span;
+        if (!Path::find(text.data(), text.size(), span, index())) {
+            return otherwise;
+        }
+        return convert<T>(span, otherwise);
+    }
+
+    // String at a compile-time path without a copy. Points into the text unless the string
+    // has escapes, then into the arena. Empty when the path is missing or null.
+    template<typename Path>
+    std::string_view view() const {
+        Span span;
+        if (!Path::find(text.data(), text.size(), span, index())) {
+            return std::string_view();
+        }
+        return viewOf(span);
+    }
+
+    // Fills `record` from ListVerifiedFields.pFieldMaps of a lexical analysis result in one
+    // pass, which stops once every field of the schema has been seen. Returns false when
+    // the text is malformed.
+    template<typename Record>
+    bool extract(const Schema<Record> &schema, Record &record) const {
+        Span *spans = scratch().template allocate<Span>(schema.size());
+        bool ok = findFields(schema.fields(), schema.size(), spans);
+
+        for (size_t i = 0; i < schema.size(); ++i) {
+            const Span &span = spans[i];
+            if (span.type == Json::Missing) {
+                continue;
+            }
+            auto &target = schema.target(i);
+            switch (target.kind) {
+            case Schema<Record>::Text:
+                record.*target.text = convert<std::string>(span, std::string());
+                break;
+            case Schema<Record>::View:
+                record.*target.view = viewOf(span);
+                break;
+            case Schema<Record>::Integer:
+                record.*target.integer = convert<long>(span, record.*target.integer);
+                break;
+            case Schema<Record>::Flag:
+                record.*target.flag = convert<bool>(span, record.*target.flag);
+                break;
+            }
+        }
+        return ok;
+    }
+
+    template<typename T>
+    void fetch(const T *t) {
+        json_reader_read_member(document(), t);
+        ++mainIt;
+    }
+
+    template<typename First, typename ...Args>
+    void fetch(const First *first, const Args *...args) {
+        json_reader_read_member(document(), first);
+        fetch(args...);
+        ++mainIt;
+    }
+
+    MemberValue getValue(MemberType type) {
+        MemberValue v;
+        document();
+
+        switch (type) {
+        case MemberType::Int:
+            v.mvInt = json_reader_get_int_value(reader);
+            break;
+        case MemberType::Double:
+            v.mvDouble = json_reader_get_double_value(reader);
+            break;
+        case MemberType::String:
+            v.mvString = json_reader_get_string_value(reader);
+            break;
+        case MemberType::Bool:
+            v.mvBool = json_reader_get_boolean_value(reader);
+            break;
+        default:
+            qDebug() << "Member type is unknown:" << type;
+            break;
+        }
+
+        end();
+        return v;
+    }
+
+    // Like getValue(String), but views the string json-glib holds for the document.
+    std::string_view getString() {
+        const gchar *value = json_reader_get_string_value(document());
+        end();
+        return value ? std::string_view(value) : std::string_view();
+    }
+
+    MemberValue searchElement(std::string, std::string, int);
+    void end();
+
+};
+
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef JSONSCHEMA_H
+#define JSONSCHEMA_H
+
+#include "jsonpath.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Json {
+
+// A member of the ListVerifiedFields.pFieldMaps element with the given wFieldType.
+struct FieldQuery {
+    int fieldType;
+    Key member;
+};
+
+// Declarative mapping from lexical analysis fields onto the members of a record, e.g.
+//   Schema<Person> schema;
+//   schema.add(8, &Person::surname).add(5, &Person::birthDate).add(51, &Person::mrzValidity, "Validity");
+// Reader::extract() fills a Person from one pass over pFieldMaps. Members whose field is
+// missing keep the value they had.
+template<typename Record>
+class Schema {
+public:
+    enum Kind {
+        Text,
+        View,
+        Integer,
+        Flag
+    };
+
+    struct Target {
+        Kind kind;
+        std::string Record::*text;
+        std::string_view Record::*view;
+        long Record::*integer;
+        bool Record::*flag;
+    };
+
+private:
+    std::vector<FieldQuery> queries;
+    std::vector<Target> targets;
+
+    Schema &push(int fieldType, const char *member, const Target &target) {
+        queries.push_back(FieldQuery{ fieldType, Key(member) });
+        targets.push_back(target);
+        return *this;
+    }
+
+public:
+    Schema &add(int fieldType, std::string Record::*to, const char *member = "Field_Visual") {
+        return push(fieldType, member, Target{ Text, to, nullptr, nullptr, nullptr });
+    }
+    // Views stay valid as long as the text and the arena of the reader do.
+    Schema &add(int fieldType, std::string_view Record::*to, const char *member = "Field_Visual") {
+        return push(fieldType, member, Target{ View, nullptr, to, nullptr, nullptr });
+    }
+    Schema &add(int fieldType, long Record::*to, const char *member = "Field_Visual") {
+        return push(fieldType, member, Target{ Integer, nullptr, nullptr, to, nullptr });
+    }
+    Schema &add(int fieldType, bool Record::*to, const char *member = "Field_Visual") {
+        return push(fieldType, member, Target{ Flag, nullptr, nullptr, nullptr, to });
+    }
+
+    size_t size() const { return queries.size(); }
+    const FieldQuery *fields() const { return queries.data(); }
+    const Target &target(size_t i) const { return targets[i]; }
+};
+
+}
+
+#endif
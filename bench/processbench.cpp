@@ -0,0 +1,167 @@
+// Drives DocumentReader::ProcessAsync() against the stub libPasspR40.so: checks that
+// stage timings, cancellation, the stage deadline, the result cache, result views and the
+// lazy result set work, and reports how long the call takes and the overhead of the SDK
+// thread.
+#include "documentreader.h"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef STUB_PASSPR40_PATH
+#define STUB_PASSPR40_PATH "libStubPasspR40.so"
+#endif
+
+namespace {
+
+const intptr_t processMode = RPRM_GetImage_Modes_GetImages | RPRM_GetImage_Modes_OCR_MRZ;
+
+int failures = 0;
+
+void check(bool ok, const std::string &what) {
+    std::cout << (ok ? "ok      " : "FAILED  ") << what << std::endl;
+    if (!ok) {
+        ++failures;
+    }
+}
+
+double millis(std::chrono::microseconds us) {
+    return us.count() / 1000.0;
+}
+
+void setDelays(int processMs, int lexicalMs) {
+    setenv("STUB_PROCESS_MS", std::to_string(processMs).c_str(), 1);
+    setenv("STUB_LEXICAL_MS", std::to_string(lexicalMs).c_str(), 1);
+}
+
+}
+
+int main(int argc, char **argv) {
+    DocumentReader reader;
+    reader.SetPasspr40LibName(argc > 1 ? argv[1] : STUB_PASSPR40_PATH);
+    if (reader.ConnectPasspr() != RPRM_Error_NoError || !reader.IsConnected()) {
+        std::cerr << "Could not connect to the stub library" << std::endl;
+        return 2;
+    }
+    std::cout << std::fixed << std::setprecision(2);
+
+    setDelays(40, 20);
+    auto called = std::chrono::steady_clock::now();
+    auto future = reader.ProcessAsync(processMode);
+    auto returned = std::chrono::steady_clock::now() - called;
+    DocumentReader::ProcessResult result = future.get();
+    std::cout << "ProcessAsync() returned after "
+              << std::chrono::duration_cast<std::chrono::microseconds>(returned).count() << " us; stages: process "
+              << millis(result.timings[DocumentReader::StageProcess]) << " ms, lexical analysis "
+              << millis(result.timings[DocumentReader::StageLexicalAnalysis]) << " ms" << std::endl;
+    check(result.code == RPRM_Error_NoError && !result.cancelled && !result.timedOut, "completes");
+    check(result.timings[DocumentReader::StageProcess] >= std::chrono::milliseconds(40)
+              && result.timings[DocumentReader::StageLexicalAnalysis] >= std::chrono::milliseconds(20),
+          "times every stage");
+
+    auto running = reader.ProcessAsync(processMode);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    reader.CancelProcess();
+    result = running.get();
+    check(result.cancelled && result.stage == DocumentReader::StageProcess
+              && result.timings[DocumentReader::StageLexicalAnalysis].count() == 0,
+          "cancels before the next stage");
+
+    std::vector<std::future<DocumentReader::ProcessResult>> queued;
+    for (int i = 0; i < 3; ++i) {
+        queued.push_back(reader.ProcessAsync(processMode));
+    }
+    reader.CancelProcess();
+    bool allCancelled = true;
+    for (auto &f : queued) {
+        allCancelled = f.get().cancelled && allCancelled;
+    }
+    check(allCancelled, "cancels queued requests");
+
+    reader.SetStageDeadline(std::chrono::milliseconds(30));
+    result = reader.ProcessAsync(processMode).get();
+    check(result.timedOut && result.stage == DocumentReader::StageProcess && result.code != RPRM_Error_NoError,
+          "stops after a stage past its deadline");
+    reader.SetStageDeadline(std::chrono::milliseconds(0));
+
+    bool onCallback = false;
+    reader.ProcessAsync(processMode, [&onCallback](const DocumentReader::ProcessResult &r) {
+        onCallback = r.code == RPRM_Error_NoError;
+    }).wait();
+    check(onCallback, "runs the callback before the future is ready");
+
+    setDelays(0, 0);
+    // Everything the scan window reads back from the graphics results, twice.
+    auto readGraphics = [&reader]() {
+        ScanResult scan;
+        reader.GetScanResult(scan);
+        size_t bytes = 0;
+        for (const auto &graphic : scan.graphics) {
+            long pageIndex = 0;
+            std::string fieldName;
+            bytes += reader.GetReaderResultFromList(RPRM_ResultType_Graphics, graphic.container, graphic.index, pageIndex, fieldName).size();
+        }
+        return bytes;
+    };
+    reader.ProcessAsync(processMode).wait();
+    bool found = readGraphics() > 0;
+    DocumentReader::ResultCacheStats first = reader.GetResultCacheStats();
+    readGraphics();
+    DocumentReader::ResultCacheStats second = reader.GetResultCacheStats();
+    std::cout << "result cache, one pass: " << first.hits << " hits, " << first.misses << " misses; two passes: "
+              << second.hits << " hits, " << second.misses << " misses" << std::endl;
+    check(found && second.misses == first.misses && second.hits > first.hits, "answers repeated reads from the cache");
+    long pageIndex = 0;
+    std::string fieldName;
+    ResultView view = reader.ViewReaderResultFromList(RPRM_ResultType_Graphics, 0, 0, pageIndex, fieldName);
+    std::vector<uint8_t> copy = view.materialize();
+    bool usable = view.valid() && view.size() > 0 && copy.size() == view.size();
+
+    reader.ProcessAsync(processMode).wait();
+    readGraphics();
+    check(reader.GetResultCacheStats().misses == first.misses, "starts over after Process()");
+    check(usable && !view.valid() && view.data() == nullptr && view.empty() && copy.size() > 0,
+          "invalidates views, keeps materialized copies after Process()");
+
+    ResultSet &results = reader.Results();
+    std::vector<size_t> graphics = results.select(ResultSet::Graphic);
+    bool listedOnly = graphics.size() == 6 && results.stats().fetched == 0;
+    DocumentReader::ResultCacheStats listed = reader.GetResultCacheStats();
+    ResultView graphic = results.fetch(graphics[0]);
+    DocumentReader::ResultCacheStats fetched = reader.GetResultCacheStats();
+    results.fetch(graphics[0]);
+    ResultSet::Stats resultStats = results.stats();
+    results.report(std::cout);
+    check(listedOnly, "lists results without fetching them");
+    check(graphic.size() > 0 && resultStats.fetched == 1 && resultStats.skipped == results.size() - 1
+              && resultStats.bytes == graphic.size() && reader.GetResultCacheStats().misses == fetched.misses
+              && fetched.misses == listed.misses,
+          "fetches an entry once, on first use");
+    bool ownBytes = true;
+    std::vector<ResultView> views;
+    for (size_t id : graphics) {
+        views.push_back(results.fetch(id));
+    }
+    for (size_t i = 0; i < graphics.size(); ++i) {
+        const ResultView &element = views[i];
+        ownBytes = ownBytes && element.size() > 0
+                   && element.data()[element.size() - 1] == static_cast<uint8_t>(results.entry(graphics[i]).element);
+    }
+    check(ownBytes, "keeps every element's bytes while the next ones are fetched");
+    reader.ProcessAsync(processMode).wait();
+    check(reader.Results().stats().fetched == 0 && reader.Results().size() == graphics.size() + 2,
+          "lists the next scan afresh");
+
+    const int rounds = 2000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        reader.ProcessAsync(processMode).wait();
+    }
+    auto perCall = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start) / rounds;
+    std::cout << "round trip through the SDK thread: " << perCall.count() / 1000.0 << " us" << std::endl;
+
+    reader.Disconnect();
+    return failures ? 1 : 0;
+}
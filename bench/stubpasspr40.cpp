@@ -0,0 +1,120 @@
+// Stand-in for libPasspR40.so: STUB_DEVICES devices (default 1), processing commands
+// that sleep for STUB_PROCESS_MS / STUB_LEXICAL_MS milliseconds, and two pages of graphics
+// with three fields each as the only results. Integer and pointer arguments only, which
+// is all DocumentReader passes through the resolved symbols. Like the real library it
+// drives one device per instance; every processing run ends with
+// RPRM_Notification_DocumentReady carrying the connected device index + 1, so callers
+// can tell which instance a notification came from.
+// The list elements of a page share one output buffer, overwritten by the next element
+// (the SDK promises no more); each one ends with its element index.
+#include <PasspR.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+long envValue(const char *variable, long fallback) {
+    const char *value = std::getenv(variable);
+    return value ? std::atol(value) : fallback;
+}
+
+void sleepFor(const char *variable) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(envValue(variable, 0)));
+}
+
+NotifyFunc notify = nullptr;
+intptr_t connectedDevice = -1;
+
+const uint32_t graphicPages = 2;
+const uint32_t graphicFields = 3;
+const uint8_t graphicImage[] = { 0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0xFF, 0xD9 };
+
+TDocGraphicField fields[graphicPages][graphicFields];
+TDocGraphicsInfo graphics[graphicPages];
+TResultContainer containers[graphicPages];
+uint8_t elementBuffers[graphicPages][sizeof(graphicImage) + 1];
+
+}
+
+extern "C" {
+
+uint32_t _LibraryVersion() {
+    return 0x00060000;
+}
+
+void _SetCallbackFunc(void *, void *notifyFunc) {
+    notify = reinterpret_cast<NotifyFunc>(notifyFunc);
+}
+
+long _Initialize(void *, void *) {
+    return RPRM_Error_NoError;
+}
+
+void _Free() {
+}
+
+long _ExecuteCommand(intptr_t command, void *params, void *result) {
+    switch (command) {
+    case RPRM_Command_Device_Count:
+        *static_cast<long *>(result) = envValue("STUB_DEVICES", 1);
+        break;
+    case RPRM_Command_Device_Connect:
+        connectedDevice = reinterpret_cast<intptr_t>(params);
+        if (connectedDevice >= envValue("STUB_DEVICES", 1)) {
+            return RPRM_Error_Failed;
+        }
+        break;
+    case RPRM_Command_Process:
+        sleepFor("STUB_PROCESS_MS");
+        if (notify) {
+            notify(RPRM_Notification_DocumentReady, (connectedDevice < 0 ? 0 : connectedDevice) + 1);
+        }
+        break;
+    case RPRM_Command_OCRLexicalAnalyze:
+        sleepFor("STUB_LEXICAL_MS");
+        break;
+    default:
+        break;
+    }
+    return RPRM_Error_NoError;
+}
+
+void *_CheckResult(intptr_t type, intptr_t index, intptr_t, intptr_t) {
+    if (type != RPRM_ResultType_Graphics || index < 0 || index >= static_cast<intptr_t>(graphicPages)) {
+        return nullptr;
+    }
+    TResultContainer &container = containers[index];
+    graphics[index].nFields = graphicFields;
+    graphics[index].pArrayFields = fields[index];
+    for (uint32_t i = 0; i < graphicFields; ++i) {
+        fields[index][i].FieldType = gf_Portrait;
+    }
+    container.result_type = RPRM_ResultType_Graphics;
+    container.page_idx = index;
+    container.buffer = &graphics[index];
+    return &container;
+}
+
+long _CheckResultFromList(void *handle, intptr_t, void *result) {
+    auto container = static_cast<TResultContainer *>(handle);
+    if (!container || container->list_idx >= graphicFields) {
+        return 0;
+    }
+    uint8_t *buffer = elementBuffers[container->page_idx];
+    std::memcpy(buffer, graphicImage, sizeof(graphicImage));
+    buffer[sizeof(graphicImage)] = static_cast<uint8_t>(container->list_idx);
+    auto element = static_cast<TResultContainer *>(result);
+    element->buffer = buffer;
+    element->buf_length = sizeof(graphicImage) + 1;
+    return gf_Portrait;
+}
+
+long _ResultTypeAvailable(intptr_t type) {
+    return type == RPRM_ResultType_Graphics ? graphicPages : 0;
+}
+
+}
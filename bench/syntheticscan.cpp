@@ -0,0 +1,111 @@
+#include "syntheticscan.h"
+
+#include <random>
+
+namespace Synthetic {
+
+namespace {
+
+const char *sampleValues[] = {
+    "P<UTOERIKSSON<<ANNA<MARIA<<<<<<<<<<<<<<<<<<<",
+    "L898902C36UTO7408122F1204159ZE184226B<<<<<10",
+    "ERIKSSON",
+    "ANNA MARIA",
+    "1974-08-12",
+    "2012-04-15",
+    "UTOPIA",
+    "L898902C3"
+};
+
+}
+
+std::string lexicalJson(size_t targetBytes) {
+    std::string json = R"({"ListVerifiedFields":{"pFieldMaps":[)";
+
+    unsigned index = 0;
+    bool serialWritten = false;
+    while (json.size() < targetBytes || !serialWritten) {
+        // Keep the interesting field towards the end so lookups walk most of the array.
+        bool last = json.size() + 600 >= targetBytes;
+        int fieldType = last && !serialWritten ? 165 : static_cast<int>(index % 160);
+        serialWritten = serialWritten || fieldType == 165;
+
+        const char *value = sampleValues[index % (sizeof(sampleValues) / sizeof(sampleValues[0]))];
+        if (index) {
+            json += ',';
+        }
+        json += R"({"FieldType":)" + std::to_string(fieldType)
+            + R"(,"wFieldType":)" + std::to_string(fieldType)
+            + R"(,"wLCID":0,"Field_MRZ":")" + value
+            + R"(","Field_Visual":")" + value
+            + R"(","Validity":)" + std::to_string(index % 7 ? 1 : 0)
+            + R"(,"Field_Barcode":null,"Field_RFID":null,"Matrix":[1,0,1,0,0,0,0,0,0,0],)"
+            + R"("FieldRect":{"left":)" + std::to_string(index * 7 % 900)
+            + R"(,"top":)" + std::to_string(index * 13 % 600)
+            + R"(,"right":)" + std::to_string(index * 7 % 900 + 120)
+            + R"(,"bottom":)" + std::to_string(index * 13 % 600 + 24)
+            + R"(},"Comment":"Field \"value\" with escapes \\ and unicode é"})";
+        ++index;
+    }
+
+    json += R"(],"Count":)" + std::to_string(index) + R"(}})";
+    return json;
+}
+
+std::string docTypeJson() {
+    return R"json({"OneCandidate":{"DocumentName":"Utopia - ePassport (2006)","ID":-274257313,"P":0.98,)json"
+        R"json("Rotated180":false,"RFID_Presence":1,"FDSIDList":{"ICAOCode":"UTO","Count":1,"List":[1],)json"
+        R"json("dType":12,"dFormat":0,"dMRZ":true,"dDescription":"Passport","dYear":"2006",)json"
+        R"json("dCountryName":"Utopia","isDeprecated":false},"NecessaryLights":6,"CheckAuthenticity":1,)json"
+        R"json("UVExp":0,"AuthenticityNecessaryLights":0,"OVIExp":0}})json";
+}
+
+std::string authenticityJson(size_t targetBytes) {
+    static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::mt19937 random(targetBytes);
+    std::string json;
+
+    unsigned index = 0;
+    while (json.size() + 64 < targetBytes) {
+        // Check types are bit flags, the last one written is always the IR/B900 check.
+        int checkType = json.size() + 20000 >= targetBytes ? 1 << 17 : 1 << (index % 17);
+        if (index) {
+            json += ',';
+        }
+        json += R"({"Type":)" + std::to_string(checkType)
+            + R"(,"Result":)" + std::to_string(index % 3 == 0 ? 2 : 1)
+            + R"(,"Count":1,"List":[{"ElementResult":1,"ElementDiagnose":1,"ElementType":)" + std::to_string(index % 40)
+            + R"(,"Area":{"left":10,"top":20,"right":300,"bottom":180},"PercentValue":)" + std::to_string(index * 37 % 100)
+            + R"(,"ElementRect":{"left":10,"top":20,"right":300,"bottom":180},"Image":{"image":")";
+        // Padded base64 of 3-12 KB of random bytes, like an encoded JPEG fragment.
+        size_t imageBytes = 3072 + random() % 9216;
+        for (size_t i = 0; i < imageBytes; i += 3) {
+            size_t left = imageBytes - i;
+            uint32_t group = random() & (left > 2 ? 0xFFFFFF : left > 1 ? 0xFFFF00 : 0xFF0000);
+            json += base64[group >> 18];
+            json += base64[(group >> 12) & 0x3F];
+            json += left > 1 ? base64[(group >> 6) & 0x3F] : '=';
+            json += left > 2 ? base64[group & 0x3F] : '=';
+        }
+        json += R"(","format":".jpg"},"EtalonImage":{"image":"","format":""},"Comment":"Pattern \"B900\" matched"}]})";
+        ++index;
+    }
+
+    return R"({"AuthenticityCheckList":{"Count":)" + std::to_string(index) + R"(,"List":[)" + json + R"(],"Result":1}})";
+}
+
+std::vector<uint8_t> image(size_t bytes, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::vector<uint8_t> result(bytes);
+    for (auto &b : result) {
+        b = static_cast<uint8_t>(random());
+    }
+    // Keep the JPEG magic so extension sniffing behaves like it does for real pages.
+    if (bytes >= 2) {
+        result[0] = 0xFF;
+        result[1] = 0xD8;
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,27 @@
+#ifndef SYNTHETICSCAN_H
+#define SYNTHETICSCAN_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Stand-ins for SDK output with the shape and size of real scans.
+namespace Synthetic {
+
+// RPRM_ResultType_OCRLexicalAnalyze JSON with pFieldMaps grown to about `targetBytes`.
+// Field type 165 (the document serial) is placed near the end like in real documents.
+std::string lexicalJson(size_t targetBytes);
+
+// RPRM_ResultType_ChosenDocumentTypeCandidate JSON.
+std::string docTypeJson();
+
+// RPRM_ResultType_Authenticity JSON with every check enabled, grown to about `targetBytes`
+// mostly by base64 images of the checked elements. The overall result comes last.
+std::string authenticityJson(size_t targetBytes);
+
+// Incompressible bytes standing in for an encoded page image.
+std::vector<uint8_t> image(size_t bytes, uint32_t seed);
+
+}
+
+#endif
@@ -0,0 +1,209 @@
+#include "httpsink.h"
+#include "syntheticscan.h"
+#include "documentsender.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+struct Config {
+    unsigned scans = 500;
+    unsigned images = 3;
+    size_t imageBytes = 300 * 1024;
+    size_t jsonBytes = 64 * 1024;
+    unsigned maxInFlight = 16;
+
+    HttpSink::Options sink;
+
+    unsigned connections = 4;
+    unsigned batch = 0;
+    unsigned batchWindowMs = 50;
+    bool lanes = false;
+    std::string compression = "none";
+    bool dedup = false;
+    double rescanRate = 1.0;
+};
+
+void usage(const char *program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --scans N            uploads to send (500)\n"
+              << "  --images N           page images per scan (3)\n"
+              << "  --image-kb N         size of each image (300)\n"
+              << "  --json-kb N          size of the lexical JSON part (64)\n"
+              << "  --in-flight N        uploads queued before the driver waits (16)\n"
+              << "  --connections N      sender connections per host (4)\n"
+              << "  --sink-threads N     sink worker threads (8)\n"
+              << "  --latency-ms N       sink delay per response (0)\n"
+              << "  --jitter-ms N        extra random sink delay (0)\n"
+              << "  --errors R           share of 503 responses, 0..1 (0)\n"
+              << "  --batch N            coalesce N scans per request (off)\n"
+              << "  --batch-window-ms N  batch flush deadline (50)\n"
+              << "  --lanes              split metadata and images on priority lanes\n"
+              << "  --compression C      none, gzip or zstd (none)\n"
+              << "  --dedup              send repeated images as content references\n"
+              << "  --rescan-rate R      share of scans repeating the previous images (1)\n";
+}
+
+bool parse(int argc, char **argv, Config &config) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char * {
+            if (i + 1 >= argc) {
+                std::cerr << arg << " needs a value" << std::endl;
+                std::exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--scans") {
+            config.scans = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--images") {
+            config.images = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--image-kb") {
+            config.imageBytes = std::strtoul(value(), nullptr, 10) * 1024;
+        } else if (arg == "--json-kb") {
+            config.jsonBytes = std::strtoul(value(), nullptr, 10) * 1024;
+        } else if (arg == "--in-flight") {
+            config.maxInFlight = std::max(1ul, std::strtoul(value(), nullptr, 10));
+        } else if (arg == "--connections") {
+            config.connections = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--sink-threads") {
+            config.sink.threads = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--latency-ms") {
+            config.sink.latency = std::chrono::milliseconds(std::strtoul(value(), nullptr, 10));
+        } else if (arg == "--jitter-ms") {
+            config.sink.jitter = std::chrono::milliseconds(std::strtoul(value(), nullptr, 10));
+        } else if (arg == "--errors") {
+            config.sink.errorRate = std::strtod(value(), nullptr);
+        } else if (arg == "--batch") {
+            config.batch = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--batch-window-ms") {
+            config.batchWindowMs = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--lanes") {
+            config.lanes = true;
+        } else if (arg == "--compression") {
+            config.compression = value();
+        } else if (arg == "--dedup") {
+            config.dedup = true;
+        } else if (arg == "--rescan-rate") {
+            config.rescanRate = std::strtod(value(), nullptr);
+        } else {
+            usage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char **argv) {
+    Config config;
+    if (!parse(argc, argv, config)) {
+        return 2;
+    }
+
+    HttpSink sink(config.sink);
+    if (!sink.start()) {
+        return 1;
+    }
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    // Payloads are built once and borrowed by every upload, so the driver itself
+    // costs next to nothing and the numbers reflect the sender and the transport.
+    const std::string lexJson = Synthetic::lexicalJson(config.jsonBytes);
+    std::vector<std::vector<uint8_t>> images;
+    for (unsigned i = 0; i < config.images; ++i) {
+        images.push_back(Synthetic::image(config.imageBytes, i + 1));
+    }
+    const size_t scanBytes = lexJson.size() + config.images * config.imageBytes;
+
+    LatencyHistogram latency;
+    std::atomic<unsigned long> failed(0);
+
+    std::chrono::steady_clock::duration elapsed;
+    {
+        DocumentSender::PoolOptions pool;
+        pool.maxHostConnections = config.connections;
+        pool.maxIdleHandles = std::max(8u, config.connections * 2);
+        DocumentSender sender(pool);
+
+        if (config.compression == "gzip") {
+            sender.setCompression(DocumentCompressor::Gzip);
+        } else if (config.compression == "zstd" && !sender.setCompression(DocumentCompressor::Zstd)) {
+            std::cerr << "zstd is not available in this build" << std::endl;
+            return 2;
+        }
+        sender.setBatching(config.batch, std::chrono::milliseconds(config.batchWindowMs));
+        sender.setLanes(config.lanes);
+        sender.setDeduplication(config.dedup);
+
+        std::mt19937 random(42);
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+        std::deque<std::future<DocumentSender::Result>> inFlight;
+        auto start = std::chrono::steady_clock::now();
+
+        for (unsigned scan = 0; scan < config.scans; ++scan) {
+            while (inFlight.size() >= config.maxInFlight) {
+                inFlight.front().wait();
+                inFlight.pop_front();
+            }
+
+            // A fresh scan gets new page bytes, a rescan repeats the last ones.
+            bool fresh = config.rescanRate < 1.0 && scan && chance(random) >= config.rescanRate;
+            if (fresh) {
+                for (auto &image : images) {
+                    std::memcpy(image.data() + 2, &scan, sizeof(scan));
+                }
+            }
+
+            sender.addMimePart("data", lexJson);
+            for (unsigned i = 0; i < config.images; ++i) {
+                std::string filename = "scan" + std::to_string(scan) + "_" + std::to_string(i) + ".jpg";
+                if (config.rescanRate < 1.0) {
+                    // Images change between scans, so every upload owns a copy.
+                    sender.addMimeBuffer("files", std::vector<uint8_t>(images[i]), filename);
+                } else {
+                    sender.addMimeBuffer("files", images[i].data(), images[i].size(), filename);
+                }
+            }
+
+            auto queuedAt = std::chrono::steady_clock::now();
+            inFlight.push_back(sender.enqueue(sink.url(), [&latency, &failed, queuedAt](const DocumentSender::Result &result) {
+                latency.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - queuedAt).count());
+                if (!result.ok()) {
+                    ++failed;
+                }
+            }));
+        }
+        for (auto &future : inFlight) {
+            future.wait();
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << sender.metricsReport() << std::endl;
+    }
+
+    sink.stop();
+    curl_global_cleanup();
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    HttpSink::Stats served = sink.stats();
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "scans:       " << config.scans << " x " << scanBytes / 1024 << " KiB"
+              << " in " << seconds * 1000.0 << " ms\n"
+              << "throughput:  " << config.scans / seconds << " scans/s, "
+              << served.requests / seconds << " req/s, "
+              << served.bytes / seconds / (1024.0 * 1024.0) << " MB/s on the wire\n"
+              << "latency us:  " << latency.summary() << "\n"
+              << "failed:      " << failed << " (sink answered " << served.errors << " with 503)\n"
+              << "sink:        " << served.requests << " requests over " << served.connections << " connections" << std::endl;
+    return failed && !config.sink.errorRate ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+#include "devicemanager.h"
+#include <QDebug>
+#include <algorithm>
+
+DeviceManager::~DeviceManager()
+{
+    close();
+}
+
+std::unique_ptr<DocumentReader> DeviceManager::makeReader(long device)
+{
+    std::unique_ptr<DocumentReader> reader(new DocumentReader());
+    if (!passpr40LibName.isEmpty()) {
+        reader->SetPasspr40LibName(passpr40LibName);
+    }
+    reader->SetDeviceIndex(device);
+    if (notificationCallback) {
+        NotificationCallback callback = notificationCallback;
+        reader->SetNotificationCallback([callback, device](intptr_t code, intptr_t value) {
+            callback(device, code, value);
+        });
+    }
+    return reader;
+}
+
+size_t DeviceManager::open(size_t maxDevices)
+{
+    close();
+
+    // The first device tells how many there are, the others connect in parallel.
+    std::unique_ptr<DocumentReader> first = makeReader(0);
+    first->ConnectAsync("").wait();
+    if (!first->IsConnected()) {
+        qDebug() << "DeviceManager: no device could be connected";
+        return 0;
+    }
+
+    size_t devices = static_cast<size_t>(std::max(first->GetDeviceCount(), 1L));
+    devices = std::min<size_t>(devices, DocumentReader::maxReaders);
+    if (maxDevices) {
+        devices = std::min(devices, maxDevices);
+    }
+    readers[0] = std::move(first);
+
+    std::vector<std::future<long>> connecting;
+    for (size_t i = 1; i < devices; ++i) {
+        readers[i] = makeReader(static_cast<long>(i));
+        connecting.push_back(readers[i]->ConnectAsync(""));
+    }
+    for (size_t i = 1; i < devices; ++i) {
+        long result = connecting[i - 1].get();
+        if (!readers[i]->IsConnected()) {
+            qDebug() << "DeviceManager: device" << i << "did not connect:" << result;
+            readers.erase(i);
+        }
+    }
+    return readers.size();
+}
+
+void DeviceManager::close()
+{
+    for (auto &reader : readers) {
+        reader.second->Disconnect();
+    }
+    readers.clear();
+}
+
+std::vector<long> DeviceManager::devices() const
+{
+    std::vector<long> result;
+    for (const auto &reader : readers) {
+        result.push_back(reader.first);
+    }
+    return result;
+}
+
+DocumentReader *DeviceManager::reader(long device)
+{
+    auto found = readers.find(device);
+    return found != readers.end() ? found->second.get() : nullptr;
+}
+
+std::future<DocumentReader::ProcessResult> DeviceManager::process(long device, intptr_t processingMode, ProcessCallback callback)
+{
+    DocumentReader *target = reader(device);
+    if (!target) {
+        std::promise<DocumentReader::ProcessResult> failed;
+        DocumentReader::ProcessResult result;
+        result.code = RPRM_Error_Failed;
+        failed.set_value(result);
+        return failed.get_future();
+    }
+
+    DocumentReader::ProcessCallback done;
+    if (callback) {
+        done = [callback, device](const DocumentReader::ProcessResult &result) {
+            callback(device, result);
+        };
+    }
+    return target->ProcessAsync(processingMode, done);
+}
+
+std::vector<std::future<DocumentReader::ProcessResult>> DeviceManager::processAll(intptr_t processingMode, ProcessCallback callback)
+{
+    std::vector<std::future<DocumentReader::ProcessResult>> result;
+    for (const auto &reader : readers) {
+        result.push_back(process(reader.first, processingMode, callback));
+    }
+    return result;
+}
@@ -0,0 +1,49 @@
+#ifndef DEVICEMANAGER_H
+#define DEVICEMANAGER_H
+
+#include "documentreader.h"
+#include <QString>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <vector>
+
+// Opens every document reader attached to the host, one DocumentReader per device. A
+// reader makes its SDK calls, connect included, on its own SDK thread and keeps its own
+// results, so scans on different devices run concurrently. Devices are named by their
+// SDK index, which also tags their notifications and results.
+class DeviceManager {
+public:
+    using NotificationCallback = std::function<void(long device, intptr_t code, intptr_t value)>;
+    using ProcessCallback = std::function<void(long device, const DocumentReader::ProcessResult &result)>;
+
+    ~DeviceManager();
+
+    // Both must be set before open().
+    void setPasspr40LibName(const QString &name) { passpr40LibName = name; }
+    void setNotificationCallback(NotificationCallback callback) { notificationCallback = callback; }
+
+    // Connects up to `maxDevices` devices (0: all of them, at most DocumentReader::maxReaders)
+    // and returns how many are open. Devices that fail to connect are left out.
+    size_t open(size_t maxDevices = 0);
+    void close();
+
+    size_t count() const { return readers.size(); }
+    std::vector<long> devices() const;
+    // nullptr when the device is not open.
+    DocumentReader *reader(long device);
+
+    std::future<DocumentReader::ProcessResult> process(long device, intptr_t processingMode, ProcessCallback callback = nullptr);
+    // Starts a scan on every device, the futures are in devices() order.
+    std::vector<std::future<DocumentReader::ProcessResult>> processAll(intptr_t processingMode, ProcessCallback callback = nullptr);
+
+private:
+    QString passpr40LibName;
+    NotificationCallback notificationCallback;
+    std::map<long, std::unique_ptr<DocumentReader>> readers;
+
+    std::unique_ptr<DocumentReader> makeReader(long device);
+};
+
+#endif // DEVICEMANAGER_H
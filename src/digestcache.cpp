@@ -0,0 +1,121 @@
+#include "digestcache.h"
+
+#include <cstring>
+
+namespace {
+
+const uint32_t roundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+inline uint32_t rotr(uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+void compress(uint32_t state[8], const uint8_t *block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = uint32_t(block[4 * i]) << 24 | uint32_t(block[4 * i + 1]) << 16 |
+               uint32_t(block[4 * i + 2]) << 8 | uint32_t(block[4 * i + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + roundConstants[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+}
+
+DigestCache::DigestCache(size_t c) :
+    capacity(c ? c : 1)
+{
+}
+
+std::string DigestCache::hash(const uint8_t *data, size_t size) {
+    // SHA-256 (FIPS 180-4). The server trusts a reference only as far as the digest
+    // resists collisions, so a fast non-cryptographic hash will not do here.
+    uint32_t state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    size_t whole = size - size % 64;
+    for (size_t offset = 0; offset < whole; offset += 64) {
+        compress(state, data + offset);
+    }
+
+    uint8_t tail[128] = {};
+    size_t rest = size - whole;
+    if (rest) {
+        std::memcpy(tail, data + whole, rest);
+    }
+    tail[rest] = 0x80;
+    size_t tailSize = rest < 56 ? 64 : 128;
+    uint64_t bits = static_cast<uint64_t>(size) * 8;
+    for (int i = 0; i < 8; ++i) {
+        tail[tailSize - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+    for (size_t offset = 0; offset < tailSize; offset += 64) {
+        compress(state, tail + offset);
+    }
+
+    static const char hex[] = "0123456789abcdef";
+    std::string value = "sha256=";
+    for (uint32_t word : state) {
+        for (int shift = 28; shift >= 0; shift -= 4) {
+            value += hex[(word >> shift) & 0xf];
+        }
+    }
+    return value;
+}
+
+bool DigestCache::touch(const std::string &digest) {
+    auto it = entries.find(digest);
+    if (it == entries.end()) {
+        return false;
+    }
+    order.splice(order.begin(), order, it->second);
+    return true;
+}
+
+void DigestCache::insert(const std::string &digest) {
+    if (touch(digest)) {
+        return;
+    }
+    order.push_front(digest);
+    entries[digest] = order.begin();
+    resize(capacity);
+}
+
+void DigestCache::erase(const std::string &digest) {
+    auto it = entries.find(digest);
+    if (it != entries.end()) {
+        order.erase(it->second);
+        entries.erase(it);
+    }
+}
+
+void DigestCache::resize(size_t c) {
+    capacity = c ? c : 1;
+    while (entries.size() > capacity) {
+        entries.erase(order.back());
+        order.pop_back();
+    }
+}
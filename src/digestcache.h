@@ -0,0 +1,29 @@
+#ifndef DIGESTCACHE_H
+#define DIGESTCACHE_H
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+// Bounded LRU of content digests the server is known to hold. Not thread-safe.
+class DigestCache {
+    size_t capacity;
+    std::list<std::string> order; // most recently used first
+    std::unordered_map<std::string, std::list<std::string>::iterator> entries;
+public:
+    explicit DigestCache(size_t = 256);
+
+    // "sha256=<64 hex digits>" of the buffer, the value of the X-Content-Digest and
+    // X-Content-Ref part headers.
+    static std::string hash(const uint8_t *, size_t);
+
+    // Marks the digest as recently used when it is present.
+    bool touch(const std::string &);
+    void insert(const std::string &);
+    void erase(const std::string &);
+    void resize(size_t);
+    size_t size() const { return entries.size(); }
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "documentcompressor.h"
+
+#include <time.h>
+
+namespace {
+
+long long threadCpuNanoseconds() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<long long>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+}
+
+DocumentCompressor::DocumentCompressor() :
+    parts(0),
+    bytesIn(0),
+    bytesOut(0),
+    cpuNanoseconds(0)
+{
+}
+
+DocumentCompressor::~DocumentCompressor() {
+    release();
+}
+
+bool DocumentCompressor::isAvailable(Codec c) {
+    switch (c) {
+    case Codec::None:
+    case Codec::Gzip:
+        return true;
+    case Codec::Zstd:
+#ifdef HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+const char *DocumentCompressor::encodingName(Codec c) {
+    switch (c) {
+    case Codec::Gzip:
+        return "gzip";
+    case Codec::Zstd:
+        return "zstd";
+    default:
+        return "identity";
+    }
+}
+
+void DocumentCompressor::release() {
+    if (gzipReady) {
+        deflateEnd(&gzip);
+        gzipReady = false;
+    }
+#ifdef HAVE_ZSTD
+    ZSTD_freeCCtx(zstd);
+    zstd = nullptr;
+#endif
+}
+
+bool DocumentCompressor::setCodec(Codec c, int l) {
+    if (c == codec && l == level) {
+        return true;
+    }
+
+    release();
+    codec = Codec::None;
+    level = 0;
+
+    switch (c) {
+    case Codec::None:
+        return true;
+    case Codec::Gzip:
+        gzip = z_stream{};
+        // 15 window bits plus 16 selects the gzip wrapper.
+        if (deflateInit2(&gzip, l, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            qDebug() << "deflateInit2() failed for level" << l;
+            return false;
+        }
+        gzipReady = true;
+        break;
+    case Codec::Zstd:
+#ifdef HAVE_ZSTD
+        zstd = ZSTD_createCCtx();
+        if (!zstd || ZSTD_isError(ZSTD_CCtx_setParameter(zstd, ZSTD_c_compressionLevel, l))) {
+            qDebug() << "ZSTD context setup failed for level" << l;
+            release();
+            return false;
+        }
+        break;
+#else
+        qDebug() << "zstd support is not compiled in";
+        return false;
+#endif
+    }
+
+    codec = c;
+    level = l;
+    return true;
+}
+
+bool DocumentCompressor::compress(const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+    long long started = threadCpuNanoseconds();
+
+    bool ok = false;
+    if (codec == Codec::Gzip) {
+        ok = compressGzip(data, size, out);
+    } else if (codec == Codec::Zstd) {
+        ok = compressZstd(data, size, out);
+    }
+
+    cpuNanoseconds += threadCpuNanoseconds() - started;
+    if (ok) {
+        ++parts;
+        bytesIn += size;
+        bytesOut += out.size();
+    }
+    return ok;
+}
+
+bool DocumentCompressor::compressGzip(const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+    if (!gzipReady || deflateReset(&gzip) != Z_OK) {
+        return false;
+    }
+
+    out.resize(deflateBound(&gzip, size));
+    gzip.next_in = const_cast<Bytef *>(data);
+    gzip.avail_in = static_cast<uInt>(size);
+    gzip.next_out = out.data();
+    gzip.avail_out = static_cast<uInt>(out.size());
+
+    int res = deflate(&gzip, Z_FINISH);
+    if (res != Z_STREAM_END) {
+        qDebug() << "deflate() failed:" << res;
+        return false;
+    }
+
+    out.resize(gzip.total_out);
+    return true;
+}
+
+bool DocumentCompressor::compressZstd(const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+#ifdef HAVE_ZSTD
+    if (!zstd) {
+        return false;
+    }
+
+    out.resize(ZSTD_compressBound(size));
+    size_t written = ZSTD_compress2(zstd, out.data(), out.size(), data, size);
+    if (ZSTD_isError(written)) {
+        qDebug() << "ZSTD_compress2() failed:" << ZSTD_getErrorName(written);
+        return false;
+    }
+
+    out.resize(written);
+    return true;
+#else
+    Q_UNUSED(data)
+    Q_UNUSED(size)
+    Q_UNUSED(out)
+    return false;
+#endif
+}
+
+DocumentCompressor::Stats DocumentCompressor::stats() const {
+    Stats s;
+    s.parts = parts;
+    s.bytesIn = bytesIn;
+    s.bytesOut = bytesOut;
+    s.cpuTime = std::chrono::nanoseconds(cpuNanoseconds.load());
+    return s;
+}
@@ -0,0 +1,67 @@
+#ifndef DOCUMENTCOMPRESSOR_H
+#define DOCUMENTCOMPRESSOR_H
+
+#include <QDebug>
+#include <zlib.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// Compresses upload parts with a context that is kept between calls.
+// Not thread-safe, except for stats().
+class DocumentCompressor {
+public:
+    enum Codec {
+        None,
+        Gzip,
+        Zstd
+    };
+
+    struct Stats {
+        unsigned long parts = 0;
+        unsigned long long bytesIn = 0;
+        unsigned long long bytesOut = 0;
+        std::chrono::nanoseconds cpuTime{ 0 };
+
+        double ratio() const { return bytesOut ? double(bytesIn) / double(bytesOut) : 0.0; }
+    };
+
+private:
+    Codec codec = Codec::None;
+    int level = 0;
+
+    z_stream gzip{};
+    bool gzipReady = false;
+#ifdef HAVE_ZSTD
+    ZSTD_CCtx *zstd = nullptr;
+#endif
+
+    std::atomic<unsigned long> parts;
+    std::atomic<unsigned long long> bytesIn;
+    std::atomic<unsigned long long> bytesOut;
+    std::atomic<long long> cpuNanoseconds;
+
+    void release();
+    bool compressGzip(const uint8_t *, size_t, std::vector<uint8_t> &);
+    bool compressZstd(const uint8_t *, size_t, std::vector<uint8_t> &);
+public:
+    DocumentCompressor();
+    ~DocumentCompressor();
+
+    static bool isAvailable(Codec);
+    static const char *encodingName(Codec);
+
+    bool setCodec(Codec, int);
+    Codec currentCodec() const { return codec; }
+    int currentLevel() const { return level; }
+
+    bool compress(const uint8_t *, size_t, std::vector<uint8_t> &);
+    Stats stats() const;
+};
+
+#endif
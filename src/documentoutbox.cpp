@@ -0,0 +1,540 @@
+#include "documentoutbox.h"
+
+#include <zlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+void appendU32(std::vector<uint8_t> &out, uint32_t value) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+void appendU64(std::vector<uint8_t> &out, uint64_t value) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+template <typename T>
+bool readValue(const uint8_t *&cursor, const uint8_t *end, T &value) {
+    if (static_cast<size_t>(end - cursor) < sizeof(value)) {
+        return false;
+    }
+    std::memcpy(&value, cursor, sizeof(value));
+    cursor += sizeof(value);
+    return true;
+}
+
+bool readU32(const uint8_t *&cursor, const uint8_t *end, uint32_t &value) {
+    return readValue(cursor, end, value);
+}
+
+bool readBytes(const uint8_t *&cursor, const uint8_t *end, const uint8_t *&data, size_t &size) {
+    uint32_t length = 0;
+    if (!readU32(cursor, end, length) || static_cast<size_t>(end - cursor) < length) {
+        return false;
+    }
+    data = cursor;
+    size = length;
+    cursor += length;
+    return true;
+}
+
+bool readString(const uint8_t *&cursor, const uint8_t *end, std::string &value) {
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    if (!readBytes(cursor, end, data, size)) {
+        return false;
+    }
+    value.assign(reinterpret_cast<const char *>(data), size);
+    return true;
+}
+
+bool readAt(int fd, uint8_t *data, size_t size, uint64_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, data + done, size - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool writeAt(int fd, const uint8_t *data, size_t size, uint64_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pwrite(fd, data + done, size - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+}
+
+DocumentOutbox::DocumentOutbox(std::string journalPath, unsigned batch, std::chrono::milliseconds interval, uint64_t compactBytes) :
+    path(journalPath),
+    compactThreshold(compactBytes),
+    syncBatch(batch),
+    syncInterval(interval),
+    lastSync(std::chrono::steady_clock::now())
+{
+}
+
+DocumentOutbox::~DocumentOutbox() {
+    if (fd >= 0) {
+        sync();
+        ::close(fd);
+    }
+}
+
+uint32_t DocumentOutbox::headerChecksum(const RecordHeader &header) {
+    RecordHeader copy = header;
+    copy.headerCrc = 0;
+    return crc32(0, reinterpret_cast<const Bytef *>(&copy), sizeof(copy));
+}
+
+bool DocumentOutbox::open() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        qDebug() << "Open outbox journal" << path.c_str() << "- FAILED by reason:" << strerror(errno);
+        return false;
+    }
+
+    if (!recover()) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    // Nothing left to replay, start over instead of growing the journal forever.
+    if (entries.empty() && fileSize > 0) {
+        if (ftruncate(fd, 0) == 0) {
+            fileSize = 0;
+            garbage = 0;
+        }
+    } else if (garbage >= compactThreshold && garbage * 2 >= fileSize) {
+        compactLocked();
+    }
+
+    qDebug() << "Outbox journal" << path.c_str() << "recovered, pending uploads:" << entries.size();
+    return true;
+}
+
+bool DocumentOutbox::recover() {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        qDebug() << "fstat() on outbox journal failed:" << strerror(errno);
+        return false;
+    }
+
+    fileSize = static_cast<uint64_t>(st.st_size);
+    if (fileSize == 0) {
+        return true;
+    }
+
+    void *mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+        qDebug() << "mmap() on outbox journal failed:" << strerror(errno);
+        return false;
+    }
+    madvise(mapped, fileSize, MADV_RANDOM);
+
+    const uint8_t *base = static_cast<const uint8_t *>(mapped);
+    uint64_t offset = 0;
+    while (fileSize - offset >= sizeof(RecordHeader)) {
+        RecordHeader header;
+        std::memcpy(&header, base + offset, sizeof(header));
+        if (header.magic != recordMagic || header.headerCrc != headerChecksum(header)) {
+            break;
+        }
+
+        uint64_t payloadOffset = offset + sizeof(header);
+        if (header.length > fileSize - payloadOffset) {
+            break;
+        }
+
+        if (header.kind == RecordKind::Append) {
+            entries[header.id] = Entry{ payloadOffset, header.length, header.payloadCrc };
+        } else if (header.kind == RecordKind::Ack) {
+            entries.erase(header.id);
+        }
+
+        if (header.id >= nextId) {
+            nextId = header.id + 1;
+        }
+        offset = payloadOffset + header.length;
+    }
+    munmap(mapped, fileSize);
+
+    garbage = offset;
+    for (auto &entry : entries) {
+        garbage -= sizeof(RecordHeader) + entry.second.length;
+    }
+
+    // Drop a torn tail left by a crash in the middle of a write.
+    if (offset < fileSize) {
+        qDebug() << "Outbox journal has a torn tail, truncating" << (fileSize - offset) << "bytes";
+        if (ftruncate(fd, offset) != 0) {
+            qDebug() << "ftruncate() on outbox journal failed:" << strerror(errno);
+            return false;
+        }
+        fileSize = offset;
+    }
+
+    return true;
+}
+
+bool DocumentOutbox::writeRecord(RecordHeader &header, const std::vector<std::pair<const void *, size_t>> &payload) {
+    header.magic = recordMagic;
+    header.length = 0;
+    uLong crc = crc32(0, nullptr, 0);
+    for (auto &piece : payload) {
+        header.length += piece.second;
+        crc = crc32_z(crc, static_cast<const Bytef *>(piece.first), piece.second);
+    }
+    header.payloadCrc = static_cast<uint32_t>(crc);
+    header.headerCrc = headerChecksum(header);
+
+    std::vector<iovec> iov;
+    iov.reserve(payload.size() + 1);
+    iov.push_back(iovec{ &header, sizeof(header) });
+    for (auto &piece : payload) {
+        iov.push_back(iovec{ const_cast<void *>(piece.first), piece.second });
+    }
+
+    uint64_t total = sizeof(header) + header.length;
+    uint64_t written = 0;
+    size_t first = 0;
+    while (written < total) {
+        int count = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+        ssize_t n = pwritev(fd, iov.data() + first, count, static_cast<off_t>(fileSize + written));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qDebug() << "Write to outbox journal failed:" << strerror(errno);
+            // Cut the partial record so the journal stays parseable.
+            if (ftruncate(fd, fileSize) != 0) {
+                qDebug() << "ftruncate() on outbox journal failed:" << strerror(errno);
+            }
+            return false;
+        }
+
+        written += n;
+        size_t advance = static_cast<size_t>(n);
+        while (first < iov.size() && advance >= iov[first].iov_len) {
+            advance -= iov[first].iov_len;
+            ++first;
+        }
+        if (first < iov.size()) {
+            iov[first].iov_base = static_cast<uint8_t *>(iov[first].iov_base) + advance;
+            iov[first].iov_len -= advance;
+        }
+    }
+
+    fileSize += total;
+    return true;
+}
+
+uint64_t DocumentOutbox::append(const Upload &upload) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd < 0) {
+        return 0;
+    }
+
+    // Layout: creation time in ms since the epoch, lane, url, header count, headers, part count, then per part
+    // name, flags, filename, type and the part bytes; all length-prefixed.
+    std::vector<uint8_t> meta;
+    std::vector<std::pair<const void *, size_t>> payload;
+    std::vector<size_t> metaSlices;
+
+    auto createdAt = std::chrono::duration_cast<std::chrono::milliseconds>(upload.createdAt.time_since_epoch());
+    appendU64(meta, static_cast<uint64_t>(createdAt.count()));
+    appendU32(meta, upload.lane);
+
+    auto flushMeta = [&]() {
+        metaSlices.push_back(meta.size());
+    };
+    auto addString = [&](const std::string &value) {
+        appendU32(meta, static_cast<uint32_t>(value.size()));
+        meta.insert(meta.end(), value.begin(), value.end());
+    };
+
+    addString(upload.url);
+    appendU32(meta, static_cast<uint32_t>(upload.headers.size()));
+    for (auto &h : upload.headers) {
+        addString(h);
+    }
+    appendU32(meta, static_cast<uint32_t>(upload.parts.size()));
+    for (auto &part : upload.parts) {
+        addString(part.name);
+        appendU32(meta, part.isFile ? 1 : 0);
+        addString(part.filename);
+        addString(part.type);
+        appendU32(meta, static_cast<uint32_t>(part.size));
+        flushMeta();
+    }
+    flushMeta();
+
+    // Interleave the metadata slices with the part bytes without copying the latter.
+    size_t begin = 0;
+    for (size_t i = 0; i < metaSlices.size(); ++i) {
+        payload.emplace_back(meta.data() + begin, metaSlices[i] - begin);
+        begin = metaSlices[i];
+        if (i < upload.parts.size()) {
+            payload.emplace_back(upload.parts[i].data, upload.parts[i].size);
+        }
+    }
+
+    RecordHeader header{};
+    header.kind = RecordKind::Append;
+    header.id = nextId;
+
+    uint64_t payloadOffset = fileSize + sizeof(RecordHeader);
+    if (!writeRecord(header, payload)) {
+        return 0;
+    }
+
+    entries[header.id] = Entry{ payloadOffset, header.length, header.payloadCrc };
+    ++nextId;
+    ++unsynced;
+    return header.id;
+}
+
+void DocumentOutbox::ack(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ackLocked(id);
+}
+
+void DocumentOutbox::ackLocked(uint64_t id) {
+    auto it = entries.find(id);
+    if (fd < 0 || it == entries.end()) {
+        return;
+    }
+    garbage += sizeof(RecordHeader) + it->second.length;
+    entries.erase(it);
+
+    if (entries.empty()) {
+        // Everything is delivered, the journal content is garbage now.
+        if (ftruncate(fd, 0) == 0) {
+            fileSize = 0;
+            garbage = 0;
+            unsynced = 1;
+            return;
+        }
+    }
+
+    RecordHeader header{};
+    header.kind = RecordKind::Ack;
+    header.id = id;
+    if (writeRecord(header, {})) {
+        garbage += sizeof(RecordHeader);
+        ++unsynced;
+    }
+
+    if (garbage >= compactThreshold && garbage * 2 >= fileSize) {
+        compactLocked();
+    }
+}
+
+bool DocumentOutbox::compactLocked() {
+    std::string compactPath = path + ".compact";
+    int out = ::open(compactPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (out < 0) {
+        qDebug() << "Open" << compactPath.c_str() << "- FAILED by reason:" << strerror(errno);
+        return false;
+    }
+
+    // Records carry no offsets, the live ones are copied byte for byte.
+    std::map<uint64_t, Entry> moved;
+    std::vector<uint8_t> record;
+    uint64_t offset = 0;
+    bool ok = true;
+    for (auto &entry : entries) {
+        record.resize(sizeof(RecordHeader) + entry.second.length);
+        ok = readAt(fd, record.data(), record.size(), entry.second.offset - sizeof(RecordHeader))
+            && writeAt(out, record.data(), record.size(), offset);
+        if (!ok) {
+            break;
+        }
+        moved[entry.first] = Entry{ offset + sizeof(RecordHeader), entry.second.length, entry.second.crc };
+        offset += record.size();
+    }
+
+    ok = ok && fdatasync(out) == 0 && rename(compactPath.c_str(), path.c_str()) == 0;
+    if (!ok) {
+        qDebug() << "Compacting outbox journal failed:" << strerror(errno);
+        ::close(out);
+        unlink(compactPath.c_str());
+        return false;
+    }
+
+    // Make the rename durable before the old file goes away.
+    std::string directory = path.find('/') == std::string::npos ? "." : path.substr(0, path.rfind('/') + 1);
+    int dir = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir >= 0) {
+        fsync(dir);
+        ::close(dir);
+    }
+
+    qDebug() << "Outbox journal compacted from" << fileSize << "to" << offset << "bytes";
+    ::close(fd);
+    fd = out;
+    fileSize = offset;
+    garbage = 0;
+    entries.swap(moved);
+    unsynced = 0;
+    lastSync = std::chrono::steady_clock::now();
+    return true;
+}
+
+bool DocumentOutbox::deadLetter(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(id);
+    if (fd < 0 || it == entries.end()) {
+        return false;
+    }
+
+    std::string deadPath = path + ".dead";
+    std::vector<uint8_t> record(sizeof(RecordHeader) + it->second.length);
+    bool ok = readAt(fd, record.data(), record.size(), it->second.offset - sizeof(RecordHeader));
+    if (ok) {
+        int dead = ::open(deadPath.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0600);
+        struct stat st;
+        ok = dead >= 0 && fstat(dead, &st) == 0
+            && writeAt(dead, record.data(), record.size(), static_cast<uint64_t>(st.st_size))
+            && fdatasync(dead) == 0;
+        if (dead >= 0) {
+            ::close(dead);
+        }
+    }
+    if (!ok) {
+        qDebug() << "Moving outbox entry" << id << "to" << deadPath.c_str() << "failed:" << strerror(errno) << ", dropping it";
+    }
+
+    ackLocked(id);
+    return ok;
+}
+
+bool DocumentOutbox::load(uint64_t id, Upload &upload) {
+    std::shared_ptr<std::vector<uint8_t>> storage;
+    {
+        // Held while reading, compaction may replace the file.
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(id);
+        if (fd < 0 || it == entries.end()) {
+            return false;
+        }
+        const Entry &entry = it->second;
+
+        storage = std::make_shared<std::vector<uint8_t>>(entry.length);
+        if (!readAt(fd, storage->data(), storage->size(), entry.offset)) {
+            qDebug() << "Read from outbox journal failed:" << strerror(errno);
+            return false;
+        }
+
+        if (crc32_z(0, storage->data(), storage->size()) != entry.crc) {
+            qDebug() << "Outbox entry" << id << "is corrupted, dropping it";
+            ackLocked(id);
+            return false;
+        }
+    }
+
+    const uint8_t *cursor = storage->data();
+    const uint8_t *end = cursor + storage->size();
+    uint32_t count = 0;
+    uint64_t createdAt = 0;
+
+    upload = Upload();
+    bool ok = readValue(cursor, end, createdAt) && readU32(cursor, end, upload.lane)
+        && readString(cursor, end, upload.url) && readU32(cursor, end, count);
+    upload.createdAt = std::chrono::system_clock::time_point(std::chrono::milliseconds(createdAt));
+    for (uint32_t i = 0; ok && i < count; ++i) {
+        std::string value;
+        ok = readString(cursor, end, value);
+        upload.headers.push_back(value);
+    }
+
+    ok = ok && readU32(cursor, end, count);
+    for (uint32_t i = 0; ok && i < count; ++i) {
+        Part part;
+        uint32_t flags = 0;
+        ok = readString(cursor, end, part.name)
+            && readU32(cursor, end, flags)
+            && readString(cursor, end, part.filename)
+            && readString(cursor, end, part.type)
+            && readBytes(cursor, end, part.data, part.size);
+        part.isFile = flags & 1;
+        upload.parts.push_back(part);
+    }
+
+    if (!ok) {
+        qDebug() << "Outbox entry" << id << "is malformed, dropping it";
+        ack(id);
+        return false;
+    }
+
+    upload.storage = storage;
+    return true;
+}
+
+std::vector<uint64_t> DocumentOutbox::pendingIds() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<uint64_t> ids;
+    ids.reserve(entries.size());
+    for (auto &entry : entries) {
+        ids.push_back(entry.first);
+    }
+    return ids;
+}
+
+size_t DocumentOutbox::pendingCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+void DocumentOutbox::maybeSync() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!unsynced) {
+        return;
+    }
+    if (unsynced >= syncBatch || std::chrono::steady_clock::now() - lastSync >= syncInterval) {
+        syncLocked();
+    }
+}
+
+void DocumentOutbox::sync() {
+    std::lock_guard<std::mutex> lock(mutex);
+    syncLocked();
+}
+
+void DocumentOutbox::syncLocked() {
+    if (fd < 0 || !unsynced) {
+        return;
+    }
+    if (fdatasync(fd) != 0) {
+        qDebug() << "fdatasync() on outbox journal failed:" << strerror(errno);
+        return;
+    }
+    unsynced = 0;
+    lastSync = std::chrono::steady_clock::now();
+}
@@ -0,0 +1,107 @@
+#ifndef DOCUMENTOUTBOX_H
+#define DOCUMENTOUTBOX_H
+
+#include <QDebug>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Append-only journal of uploads that have not been acknowledged by the server yet.
+// Every upload is written as one record, a later ack record retires it. Recovery only
+// walks the record headers through a read-only mapping; payloads are read and checked
+// when an entry is replayed. Once retired records take `compactThreshold` bytes and half
+// of the file, the live records are copied to a fresh journal that replaces the old one.
+class DocumentOutbox {
+public:
+    struct Part {
+        std::string name;
+        bool isFile = false;
+        std::string filename;
+        std::string type;
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+    };
+
+    struct Upload {
+        std::chrono::system_clock::time_point createdAt;
+        // Opaque to the outbox, the sender's scheduling lane.
+        uint32_t lane = 0;
+        std::string url;
+        std::vector<std::string> headers;
+        std::vector<Part> parts;
+        // Backs the part data of a loaded upload.
+        std::shared_ptr<const std::vector<uint8_t>> storage;
+    };
+
+private:
+    enum RecordKind : uint32_t {
+        Append = 1,
+        Ack = 2
+    };
+
+    struct RecordHeader {
+        uint32_t magic;
+        uint32_t kind;
+        uint64_t id;
+        uint64_t length;
+        uint32_t payloadCrc;
+        uint32_t headerCrc;
+    };
+
+    struct Entry {
+        uint64_t offset;
+        uint64_t length;
+        uint32_t crc;
+    };
+
+    static const uint32_t recordMagic = 0x584f4252; // "RBOX"
+
+    std::string path;
+    int fd = -1;
+    uint64_t fileSize = 0;
+    uint64_t nextId = 1;
+    std::map<uint64_t, Entry> entries;
+    // Bytes taken by retired records and ack records.
+    uint64_t garbage = 0;
+    uint64_t compactThreshold;
+
+    unsigned syncBatch;
+    std::chrono::milliseconds syncInterval;
+    unsigned unsynced = 0;
+    std::chrono::steady_clock::time_point lastSync;
+
+    std::mutex mutex;
+
+    static uint32_t headerChecksum(const RecordHeader &);
+    bool recover();
+    bool writeRecord(RecordHeader &, const std::vector<std::pair<const void *, size_t>> &);
+    void ackLocked(uint64_t);
+    bool compactLocked();
+    void syncLocked();
+public:
+    explicit DocumentOutbox(std::string, unsigned = 16, std::chrono::milliseconds = std::chrono::milliseconds(200),
+        uint64_t = 64 << 20);
+    ~DocumentOutbox();
+
+    bool open();
+    bool isOpen() const { return fd >= 0; }
+
+    uint64_t append(const Upload &);
+    void ack(uint64_t);
+    // Copies the record to "<path>.dead", in the journal format, and acks it.
+    bool deadLetter(uint64_t);
+    bool load(uint64_t, Upload &);
+
+    std::vector<uint64_t> pendingIds();
+    size_t pendingCount();
+
+    // Flushes batched appends when the batch is full or the interval has passed.
+    void maybeSync();
+    void sync();
+};
+
+#endif
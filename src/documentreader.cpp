@@ -1,4 +1,6 @@
 #include "documentreader.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <thread>
@@ -9,23 +11,79 @@
 
 using namespace rfid;
 
-DocumentReader *DocumentReader::reader = nullptr;
-NotifyFunc DocumentReader::notificationCallback = nullptr;
-RFID_NotifyFunc DocumentReader::rfidNotificationCallback = nullptr;
+std::array<std::atomic<DocumentReader*>, DocumentReader::maxReaders> DocumentReader::readers{};
+
+template<int Slot>
+void DocumentReader::ResultReceivingCallback(TResultContainer *result, uint32_t *PostAction, uint32_t *PostActionParameter)
+{
+    Q_UNUSED( PostAction )
+    Q_UNUSED( PostActionParameter )
+
+    DocumentReader *reader = readers[Slot];
+    if(!reader || !reader->VdCallback)
+        return;
+
+    reader->VdCallback(result);
+}
+
+template<int Slot>
+void DocumentReader::NotifyCallback(intptr_t code, intptr_t value)
+{
+    if(DocumentReader *reader = readers[Slot])
+    {
+        reader->OnNotification(code, value);
+    }
+}
+
+template<int Slot>
+void DocumentReader::RFID_NotifyCallback(int code, void *value)
+{
+    if(DocumentReader *reader = readers[Slot])
+    {
+        reader->OnRfidNotification(code, value);
+    }
+}
+
+static_assert(DocumentReader::maxReaders == 4, "one slotCallbacks entry per reader");
+const DocumentReader::SlotCallbacks DocumentReader::slotCallbacks[DocumentReader::maxReaders] = {
+    { reinterpret_cast<ResultReceivingFunc>(&ResultReceivingCallback<0>), reinterpret_cast<NotifyFunc>(&NotifyCallback<0>), (RFID_NotifyFunc)&RFID_NotifyCallback<0> },
+    { reinterpret_cast<ResultReceivingFunc>(&ResultReceivingCallback<1>), reinterpret_cast<NotifyFunc>(&NotifyCallback<1>), (RFID_NotifyFunc)&RFID_NotifyCallback<1> },
+    { reinterpret_cast<ResultReceivingFunc>(&ResultReceivingCallback<2>), reinterpret_cast<NotifyFunc>(&NotifyCallback<2>), (RFID_NotifyFunc)&RFID_NotifyCallback<2> },
+    { reinterpret_cast<ResultReceivingFunc>(&ResultReceivingCallback<3>), reinterpret_cast<NotifyFunc>(&NotifyCallback<3>), (RFID_NotifyFunc)&RFID_NotifyCallback<3> },
+};
 
 
 DocumentReader::DocumentReader() :
-    passpr40Connected(false),
-    hasDocument(false),
-    RFIDConnected(false)
+    processSerial(0),
+    cancelledSerial(0),
+    stageDeadline(0),
+    resultGeneration(1),
+    rfidRead(false)
 {
-    Disconnect();
-    reader = this;
+    for(int i = 0; i < maxReaders && slot < 0; ++i)
+    {
+        DocumentReader *expected = nullptr;
+        if(readers[i].compare_exchange_strong(expected, this))
+            slot = i;
+    }
+    if(slot < 0)
+        qDebug() << "No callback slot left, at most" << maxReaders << "readers per process";
 }
 
 DocumentReader::~DocumentReader()
 {
+    CancelProcess();
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        stopping = true;
+    }
+    jobsChanged.notify_all();
+    if(sdkThread.joinable())
+        sdkThread.join();
+    WaitForRfid();
     Disconnect();
+    if(slot >= 0)
+        readers[slot] = nullptr;
 }
 
 bool DocumentReader::IsConnected()
@@ -43,53 +101,13 @@ bool DocumentReader::HasDocument()
     return hasDocument;
 }
 
-void DocumentReader::ResultReceivingCallback(TResultContainer *result, uint32_t *PostAction, uint32_t *PostActionParameter)
-{
-    Q_UNUSED( PostAction )
-    Q_UNUSED( PostActionParameter )
-
-    if(!reader)
-        return;
-
-    reader->VdCallback(result);
-}
-
-void DocumentReader::NotifyCallback(intptr_t code, intptr_t value)
+void DocumentReader::OnNotification(intptr_t code, intptr_t value)
 {
-    qDebug() << "Notification" << code << ":" << value;
+    qDebug() << "Notification" << code << ":" << value << "(reader" << slot << ")";
     switch (code)
     {
         case RPRM_Notification_DocumentReady:
-            {
-                if(reader)
-                {
-                    reader->hasDocument = value;
-                }
-            }
-            break;
-        case RPRM_Notification_Calibration:
-            {
-                if(reader)
-                {
-                    reader->hasDocument = reader->hasDocument;
-                }
-            }
-            break;
-        case RPRM_Notification_CalibrationProgress:
-            {
-                if(reader)
-                {
-                    reader->hasDocument = reader->hasDocument;
-                }
-            }
-            break;
-        case RPRM_Notification_CalibrationStep:
-            {
-                if(reader)
-                {
-                    reader->hasDocument = reader->hasDocument;
-                }
-            }
+            hasDocument = value;
             break;
         default:
             break;
@@ -100,14 +118,17 @@ void DocumentReader::NotifyCallback(intptr_t code, intptr_t value)
     }
 }
 
-void DocumentReader::RFID_NotifyCallback(int code, void *value)
+void DocumentReader::OnRfidNotification(int code, void *value)
 {
-    qDebug() << "RFID notification: " << Qt::hex << code << Qt::dec << ":" << value;
+    qDebug() << "RFID notification: " << Qt::hex << code << Qt::dec << ":" << value << "(reader" << slot << ")";
     switch(code)
     {
         case RFID_Notification_DocumentReady:
             qDebug() << "RFID_Notification_DocumentReady:" << (int)(intptr_t)value;
         break;
+        case RFID_Notification_PCSC_ReadingDatagroup:
+            MarkRfidFile((int)(intptr_t)value);
+        break;
     }
     if(rfidNotificationCallback)
     {
@@ -115,8 +136,20 @@ void DocumentReader::RFID_NotifyCallback(int code, void *value)
     }
 }
 
+std::future<long> DocumentReader::ConnectAsync(const std::string name)
+{
+    auto promise = std::make_shared<std::promise<long>>();
+    std::future<long> future = promise->get_future();
+    Post([this, name, promise]() {
+        promise->set_value(Connect(name));
+    });
+    return future;
+}
+
 long DocumentReader::Connect(const std::string name)
 {
+    if(!OnSdkThread())
+        return Call([&]() { return Connect(name); });
     Q_UNUSED( name )
     long result = RPRM_Error_Failed;
     result = ConnectPasspr();
@@ -130,15 +163,20 @@ long DocumentReader::Connect(const std::string name)
 
 long DocumentReader::ConnectPasspr()
 {
+    if(!OnSdkThread())
+        return Call([this]() { return ConnectPasspr(); });
     if (passpr40Connected)
         return RPRM_Error_AlreadyDone;
 
     long result = RPRM_Error_Failed;
     hasDocument = false;
     qDebug() << "Connecting PasspR40...";
+    if (slot < 0)
+        return result;
     if (!passrp40Lib.isLoaded())
     {
         passrp40Lib.setFileName(passpr40LibName);
+        passrp40Lib.setIsolated(slot > 0);
         passrp40Lib.setLoadHints(QLibrary::ResolveAllSymbolsHint);
         qDebug() << "Open PasspR40 lib...";
         if (!passrp40Lib.load())
@@ -161,10 +199,7 @@ long DocumentReader::ConnectPasspr()
 
     uint32_t libVersion = LibraryVersion();
     qDebug() << "Library version:" << QString("%1.%2").arg(HIWORD(libVersion)).arg(LOWORD(libVersion));
-    SetCallbackFunc(
-        reinterpret_cast<ResultReceivingFunc>(&ResultReceivingCallback),
-        reinterpret_cast<NotifyFunc>(&NotifyCallback)
-    );
+    SetCallbackFunc(slotCallbacks[slot].result, slotCallbacks[slot].notify);
     qDebug() << "Start initialize...";
     Initialize(nullptr, nullptr);
     intptr_t doLog = 1;
@@ -179,11 +214,12 @@ long DocumentReader::ConnectPasspr()
     qDebug() << "Build log result:" << Qt::hex << result << Qt::dec;
     long devCount = 0;
     result = ExecuteCommand(RPRM_Command_Device_Count, nullptr, &devCount);
+    deviceCount = devCount;
     qDebug () << "Devices count result:" << Qt::hex << result << Qt::dec << Qt::endl << "Found devices:" << devCount;
-    if(devCount > 0)
+    if(devCount > 0 && devCount > deviceIndex)
     {
-        qDebug() << "Device connecting start...";
-        result = ExecuteCommand(RPRM_Command_Device_Connect, reinterpret_cast<void*>(-1), nullptr);
+        qDebug() << "Device" << deviceIndex << "connecting start...";
+        result = ExecuteCommand(RPRM_Command_Device_Connect, reinterpret_cast<void*>(deviceIndex), nullptr);
         qDebug() << "Device connecting result:" << Qt::hex << result << Qt::dec;
 
         if(result == RPRM_Error_NoError)
@@ -192,7 +228,7 @@ long DocumentReader::ConnectPasspr()
             std::this_thread::sleep_for(std::chrono::milliseconds(300));
         }
 
-        ExecuteCommand(RPRM_Command_Device_Features, reinterpret_cast<void *>(devCount - 1), &deviceProps);
+        ExecuteCommand(RPRM_Command_Device_Features, reinterpret_cast<void *>(deviceIndex >= 0 ? deviceIndex : devCount - 1), &deviceProps);
     }
     else
     {
@@ -217,15 +253,21 @@ long DocumentReader::ConnectPasspr()
 
 long DocumentReader::ConnectRFID()
 {
+    if(!OnSdkThread())
+        return Call([this]() { return ConnectRFID(); });
     if (RFIDConnected)
         return RPRM_Error_AlreadyDone;
 
     long res = RPRM_Error_Failed;
     hasRfid = false;
+    if (slot < 0)
+        return res;
     qDebug() << "Connecting RFID...";
     if (!RFIDLib.isLoaded())
     {
         RFIDLib.setFileName(RFIDLibName);
+        RFIDLib.setIsolated(slot > 0);
+        RFIDLib.setNamespaceOf(&passrp40Lib);
         RFIDLib.setLoadHints(QLibrary::ResolveAllSymbolsHint);
         qDebug() << "Open RFID lib...";
         if (!RFIDLib.load())
@@ -254,14 +296,21 @@ long DocumentReader::ConnectRFID()
     qDebug() << "Library version:" << QString("%1.%2").arg(HIWORD(libVersion)).arg(LOWORD(libVersion));
     res = RFID_Initialize(0);
     qDebug() << "RFID initialize result:" << Qt::hex << res << Qt::dec;
-    RFID_SetCallbackFunc((RFID_NotifyFunc)&RFID_NotifyCallback);
+    RFID_SetCallbackFunc(slotCallbacks[slot].rfid);
+    LoadRfidProfiles();
     long devCount = 0;
     res = RFID_ExecuteCommand(RFID_Command_Get_DeviceCount, nullptr, &devCount);
-    devCount = 0;
+    if(!rfidEnabled)
+    {
+        qDebug() << "RFID reading is disabled, found devices:" << devCount;
+        devCount = 0;
+    }
     qDebug () << "Devices count result:" << Qt::hex << res << Qt::dec << Qt::endl << "Found devices:" << devCount;
     if(devCount > 0)
     {
+        // The n-th Regula RFID reader goes with PasspR device n.
         int regulaReaderIndex = 0;
+        long regulaReaders = 0;
         for(int devIter = 0; devIter < devCount; ++devIter)
         {
             char* devDesc = nullptr;
@@ -271,7 +320,8 @@ long DocumentReader::ConnectRFID()
                 qDebug() << devIter << ":" << devDesc;
                 std::string devDescString(devDesc);
                 if ((devDescString.find("Regula") != std::string::npos) &&
-                        (devDescString.find("RFID") != std::string::npos))
+                        (devDescString.find("RFID") != std::string::npos) &&
+                        regulaReaders++ == std::max(deviceIndex, 0L))
                 {
                     regulaReaderIndex = devIter;
                     break;
@@ -295,6 +345,10 @@ long DocumentReader::ConnectRFID()
 
 long DocumentReader::Disconnect()
 {
+    CancelProcess();
+    if(!OnSdkThread())
+        return Call([this]() { return Disconnect(); });
+    WaitForRfid();
     qDebug() << "Disconnecting... ";
     long result = 0;
     result = DisconnectRfid();
@@ -306,6 +360,9 @@ long DocumentReader::Disconnect()
 
 long DocumentReader::DisconnectPasspr()
 {
+    if(!OnSdkThread())
+        return Call([this]() { return DisconnectPasspr(); });
+    InvalidateResults();
     if(passpr40Connected)
     {
         passpr40Connected = false;
@@ -335,6 +392,8 @@ long DocumentReader::DisconnectPasspr()
 
 long DocumentReader::DisconnectRfid()
 {
+    if(!OnSdkThread())
+        return Call([this]() { return DisconnectRfid(); });
     if(RFIDConnected)
     {
         RFIDConnected = false;
@@ -364,44 +423,275 @@ long DocumentReader::DisconnectRfid()
 
 long DocumentReader::Process(intptr_t processingMode)
 {
-     long result = RPRM_Error_NoError;
-     try
-     {
-         if(RFIDConnected && RFID_ExecuteCommand)
-         {
-             RFID_ExecuteCommand(RFID_Command_Session_Close, nullptr, nullptr);
-             RFID_ExecuteCommand(RFID_Command_ClearResults, nullptr, nullptr);
-         }
-
-         result = ExecuteCommand(RPRM_Command_Process, (void*)processingMode, nullptr);
-         if(result == RPRM_Error_NoError)
-         {
-             result = ExecuteCommand(RPRM_Command_OCRLexicalAnalyze, nullptr, nullptr);
-             if((result == RPRM_Error_NoError) && RFIDConnected)
-             {
-                // create scenario XML
-                // with MRZ/CAN
-                std::string rfidScenario = R"({"RFIDTEST_OPTIONS":{"AuthProcType":2,"AuxVerification_CommunityID":false,"AuxVerification_DateOfBirth":false,"BaseSMProcedure":1,"OnlineTA":false,"OnlineTAToSignDataType":0,"PACE_StaticBinding":false,"PKD_DSCert_Priority":false,"PKD_EAC":"","PKD_PA":"","PKD_UseExternalCSCA":false,"PassiveAuth":true,"Perform_RestrictedIdentification":false,"ProfilerType":1,"ReadingBuffer":0,"SkipAA":false,"StrictProcessing":false,"TerminalType":1,"TrustedPKD":false,"UniversalAccessRights":false,"Use_SFI":false,"Write_eID":false,"SignManagementAction":0,"eSignPIN_Default":"","eSignPIN_NewValue":"","Authorized_ST_Signature":false,"Authorized_ST_QSignature":false,"Authorized_Write_DG17":false,"Authorized_Write_DG18":false,"Authorized_Write_DG19":false,"Authorized_Write_DG20":false,"Authorized_Write_DG21":false,"Authorized_Verify_Age":false,"Authorized_Verify_CommunityID":false,"Authorized_PrivilegedTerminal":false,"Authorized_CAN_Allowed":false,"Authorized_PIN_Managment":false,"Authorized_Install_Cert":false,"Authorized_Install_QCert":false,"Read_ePassport":true,"ePassport":{"DG1":true,"DG2":true,"DG3":true,"DG4":true,"DG5":true,"DG6":true,"DG7":true,"DG8":true,"DG9":true,"DG10":true,"DG11":true,"DG12":true,"DG13":true,"DG14":true,"DG15":true,"DG16":true},"Read_eID":false,"Read_eDL":false,"PACEPasswordType":1,"MRZ":")";
-                rfidScenario += GetRfidKey();
-                rfidScenario += R"("}})";
-                char* scenarioResult = nullptr;
-                int res = RFID_ExecuteCommand((int)RFID_Command_Scenario_Process, (void*)rfidScenario.c_str(), (void*)&scenarioResult);
-                if(res == RFID_Error_NoError)
-                {
-                    result = RPRM_Error_NoError;
-                }
-             }
-         }
-     }
-     catch(...)
-     {
+    if(!OnSdkThread())
+        return Call([&]() { return Process(processingMode); });
+    ProcessResult result;
+    return RunStages(processingMode, 0, result, nullptr);
+}
+
+long DocumentReader::RunStages(intptr_t processingMode, uint64_t serial, ProcessResult &result, RfidCallback rfidCallback)
+{
+    // The previous chip read uses the RFID session closed below.
+    WaitForRfid();
+    rfidRead = false;
+    InvalidateResults();
+
+    // Checked before every stage and after it returns.
+    auto interrupted = [&](Stage stage, std::chrono::steady_clock::time_point started) {
+        auto elapsed = std::chrono::steady_clock::now() - started;
+        result.timings[stage] = std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+        long deadline = serial ? stageDeadline.load() : 0;
+        if(deadline && elapsed > std::chrono::milliseconds(deadline))
+        {
+            qDebug() << "Processing stage" << stage << "ran past its deadline of" << deadline << "ms";
+            result.timedOut = true;
+        }
+        else if(serial && serial <= cancelledSerial)
+        {
+            result.cancelled = true;
+        }
+        else
+        {
+            return false;
+        }
+        result.stage = stage;
+        result.code = RPRM_Error_Failed;
+        return true;
+    };
+
+    result.code = RPRM_Error_NoError;
+    try
+    {
+        auto started = std::chrono::steady_clock::now();
+        if(interrupted(StageProcess, started))
+            return result.code;
+
+        if(RFIDConnected && RFID_ExecuteCommand)
+        {
+            RFID_ExecuteCommand(RFID_Command_Session_Close, nullptr, nullptr);
+            RFID_ExecuteCommand(RFID_Command_ClearResults, nullptr, nullptr);
+        }
+
+        result.code = ExecuteCommand(RPRM_Command_Process, (void*)processingMode, nullptr);
+        if(interrupted(StageProcess, started) || result.code != RPRM_Error_NoError)
+            return result.code;
+
+        started = std::chrono::steady_clock::now();
+        result.code = ExecuteCommand(RPRM_Command_OCRLexicalAnalyze, nullptr, nullptr);
+        if(interrupted(StageLexicalAnalysis, started) || result.code != RPRM_Error_NoError || !RFIDConnected)
+            return result.code;
+
+        started = std::chrono::steady_clock::now();
+        if(interrupted(StageRfid, started))
+            return result.code;
+
+        std::string rfidKey = GetRfidKey();
+        if(rfidCallback)
+        {
+            // The chip is read while the caller extracts the optical results.
+            rfidThread = std::thread(&DocumentReader::RfidLoop, this, std::move(rfidKey), rfidCallback, serial ? stageDeadline.load() : 0);
+            result.rfidPending = true;
+            interrupted(StageRfid, started);
+            return result.code;
+        }
+
+        if(ReadRfid(rfidKey) == RFID_Error_NoError)
+        {
+            result.code = RPRM_Error_NoError;
+        }
+        interrupted(StageRfid, started);
+    }
+    catch(...)
+    {
+
+    }
+    return result.code;
+}
+
+int DocumentReader::ReadRfid(const std::string &rfidKey)
+{
+    // scenario JSON of the selected profile
+    // with MRZ/CAN
+    std::string rfidScenario;
+    {
+        std::lock_guard<std::mutex> lock(rfidMutex);
+        const RfidProfile *profile = rfidProfiles.find(rfidProfileName);
+        if(!profile || !profile->compiled())
+        {
+            qDebug() << "RFID profile" << rfidProfileName.c_str() << "not found, reading with the default profile";
+            profile = rfidProfiles.find("default");
+        }
+        rfidScenario = profile->scenario(rfidKey);
+        rfidTimings.clear();
+        rfidFile = 0;
+        rfidFileStarted = std::chrono::steady_clock::now();
+    }
+    char* scenarioResult = nullptr;
+    int res = RFID_ExecuteCommand((int)RFID_Command_Scenario_Process, (void*)rfidScenario.c_str(), (void*)&scenarioResult);
+    MarkRfidFile(-1);
+    rfidRead = true;
+    return res;
+}
+
+void DocumentReader::MarkRfidFile(int file)
+{
+    std::lock_guard<std::mutex> lock(rfidMutex);
+    if(rfidFile < 0)
+        return;
+    auto now = std::chrono::steady_clock::now();
+    RfidTiming timing;
+    timing.file = rfidFile;
+    timing.duration = std::chrono::duration_cast<std::chrono::microseconds>(now - rfidFileStarted);
+    rfidTimings.push_back(timing);
+    rfidFile = file;
+    rfidFileStarted = now;
+}
+
+void DocumentReader::LoadRfidProfiles()
+{
+    std::lock_guard<std::mutex> lock(rfidMutex);
+    rfidProfiles = RfidProfiles();
+    if(!rfidProfilesPath.isEmpty())
+        rfidProfiles.load(rfidProfilesPath);
+    rfidProfiles.compile();
+    for(const std::string &name : rfidProfiles.names())
+        qDebug() << "RFID profile:" << name.c_str();
+}
+
+void DocumentReader::SetRfidProfile(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(rfidMutex);
+    rfidProfileName = name;
+}
+
+std::vector<DocumentReader::RfidTiming> DocumentReader::GetRfidTimings()
+{
+    std::lock_guard<std::mutex> lock(rfidMutex);
+    return rfidTimings;
+}
+
+void DocumentReader::RfidLoop(std::string rfidKey, RfidCallback callback, long deadline)
+{
+    RfidResult result;
+    auto started = std::chrono::steady_clock::now();
+    try
+    {
+        result.code = ReadRfid(rfidKey);
+    }
+    catch(...)
+    {
+        result.code = RPRM_Error_Failed;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    result.duration = std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+    result.timedOut = deadline && elapsed > std::chrono::milliseconds(deadline);
+    result.dataGroups = GetRfidTimings();
+    callback(result);
+}
+
+void DocumentReader::WaitForRfid()
+{
+    if(rfidThread.joinable() && std::this_thread::get_id() != rfidThread.get_id())
+        rfidThread.join();
+}
+
+std::future<DocumentReader::ProcessResult> DocumentReader::ProcessAsync(intptr_t processingMode, ProcessCallback callback, RfidCallback rfidCallback)
+{
+    auto promise = std::make_shared<std::promise<ProcessResult>>();
+    std::future<ProcessResult> future = promise->get_future();
+    uint64_t serial = ++processSerial;
+
+    Post([this, processingMode, serial, promise, callback, rfidCallback]() {
+        // The RFID callback never overtakes the processing result.
+        std::promise<void> reported;
+        std::shared_future<void> processReported = reported.get_future().share();
+        RfidCallback rfidDone;
+        if(rfidCallback)
+        {
+            rfidDone = [processReported, rfidCallback](const RfidResult &rfidResult) {
+                processReported.wait();
+                rfidCallback(rfidResult);
+            };
+        }
+
+        ProcessResult result;
+        if(passpr40Connected && ExecuteCommand)
+        {
+            RunStages(processingMode, serial, result, rfidDone);
+        }
+        else
+        {
+            result.code = RPRM_Error_Failed;
+        }
+        if(callback)
+            callback(result);
+        promise->set_value(result);
+        reported.set_value();
+    });
+    return future;
+}
+
+void DocumentReader::Post(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        if(!sdkThread.joinable())
+            sdkThread = std::thread(&DocumentReader::sdkLoop, this);
+        jobs.push_back(std::move(job));
+    }
+    jobsChanged.notify_all();
+}
+
+bool DocumentReader::OnSdkThread()
+{
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    return stopping || std::this_thread::get_id() == sdkThread.get_id();
+}
+
+void DocumentReader::CancelProcess()
+{
+    cancelledSerial = processSerial.load();
+}
 
-     }
-     return result;
+void DocumentReader::SetStageDeadline(std::chrono::milliseconds deadline)
+{
+    stageDeadline = static_cast<long>(deadline.count());
+}
+
+void DocumentReader::sdkLoop()
+{
+    std::unique_lock<std::mutex> lock(jobsMutex);
+    while(true)
+    {
+        jobsChanged.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if(jobs.empty())
+            break;
+
+        std::function<void()> job = std::move(jobs.front());
+        jobs.pop_front();
+        lock.unlock();
+        job();
+        lock.lock();
+    }
+}
+
+std::future<long> DocumentReader::CalibrateAsync(std::function<void(long)> callback)
+{
+    auto promise = std::make_shared<std::promise<long>>();
+    std::future<long> future = promise->get_future();
+    Post([this, promise, callback]() {
+        long result = Calibrate();
+        if(callback)
+            callback(result);
+        promise->set_value(result);
+    });
+    return future;
 }
 
 long DocumentReader::Calibrate()
 {
+    if(!OnSdkThread())
+        return Call([this]() { return Calibrate(); });
     long result = 0;
     result = ExecuteCommand(RPRM_Command_Device_Calibration, nullptr, nullptr);
     return result;
@@ -409,18 +699,81 @@ long DocumentReader::Calibrate()
 
 long DocumentReader::SetAuthenticityChecks(intptr_t authCheckMode)
 {
+    if(!OnSdkThread())
+        return Call([&]() { return SetAuthenticityChecks(authCheckMode); });
     long result = 0;
     result = ExecuteCommand(RPRM_Command_Options_Set_AuthenticityCheckMode, (void*)authCheckMode, nullptr);
     return result;
 }
 
 
+void DocumentReader::InvalidateResults()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    ++resultGeneration;
+    resultCacheStats = ResultCacheStats();
+    elementCache.clear();
+}
+
+HANDLE DocumentReader::CachedCheckResult(long resultType, long index, long format)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    CachedResult &cached = resultCache[std::make_tuple(resultType, index, format)];
+    if(cached.generation == resultGeneration)
+    {
+        ++resultCacheStats.hits;
+        return cached.handle;
+    }
+    ++resultCacheStats.misses;
+    cached.handle = CheckResult(resultType, index, format, 0);
+    cached.generation = resultGeneration;
+    return cached.handle;
+}
+
+ResultView DocumentReader::CachedElement(HANDLE container, long index, const TResultContainer &element)
+{
+    // A copy handed out before stays where it is, later views share it.
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto cached = elementCache.emplace(std::make_pair(container, index), std::vector<uint8_t>());
+    std::vector<uint8_t> &bytes = cached.first->second;
+    if(cached.second)
+    {
+        auto data = static_cast<const uint8_t*>(element.buffer);
+        bytes.assign(data, data + element.buf_length);
+    }
+    return ResultView(bytes.data(), bytes.size(), resultGeneration);
+}
+
+long DocumentReader::CachedResultsCount(long resultType)
+{
+    // Counts share the cache under index -1.
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    CachedResult &cached = resultCache[std::make_tuple(resultType, -1L, -1L)];
+    if(cached.generation == resultGeneration)
+    {
+        ++resultCacheStats.hits;
+        return cached.count;
+    }
+    ++resultCacheStats.misses;
+    cached.count = ResultTypeAvailable(resultType);
+    cached.generation = resultGeneration;
+    return cached.count;
+}
+
+DocumentReader::ResultCacheStats DocumentReader::GetResultCacheStats()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return resultCacheStats;
+}
+
 long DocumentReader::GetReaderResultsCount(eRPRM_ResultType resultType)
 {
+    if(!OnSdkThread())
+        return Call([&]() { return GetReaderResultsCount(resultType); });
     long result = 0;
     if(passpr40Connected && ResultTypeAvailable)
     {
-        result = ResultTypeAvailable(resultType);
+        result = CachedResultsCount(resultType);
     }
     return result;
 }
@@ -433,10 +786,12 @@ std::string DocumentReader::GetTextField(const eVisualFieldType fieldType)
 
 std::string DocumentReader::GetTextField(const std::vector<eVisualFieldType>& fieldType)
 {
+    if(!OnSdkThread())
+        return Call([&]() { return GetTextField(fieldType); });
     std::string result;
     if(passpr40Connected && CheckResult)
     {
-        HANDLE hResult = CheckResult(RPRM_ResultType_OCRLexicalAnalyze, 0, 0, 0);
+        HANDLE hResult = CachedCheckResult(RPRM_ResultType_OCRLexicalAnalyze, 0, 0);
         if(reinterpret_cast<intptr_t>(hResult) > 0)
         {
             auto lexResult = static_cast<TListVerifiedFields*>((static_cast<TResultContainer*>(hResult))->buffer);
@@ -461,7 +816,7 @@ std::string DocumentReader::GetTextField(const std::vector<eVisualFieldType>& fi
         }
         else
         {
-            hResult = CheckResult(RPRM_ResultType_MRZ_OCR_Extended, 0, 0, 0);
+            hResult = CachedCheckResult(RPRM_ResultType_MRZ_OCR_Extended, 0, 0);
             if(reinterpret_cast<intptr_t>(hResult) > 0)
             {
                 auto mrzResult = static_cast<TDocVisualExtendedInfo*>((static_cast<TResultContainer*>(hResult))->buffer);
@@ -485,6 +840,278 @@ std::string DocumentReader::GetTextField(const std::vector<eVisualFieldType>& fi
     return result;
 }
 
+static std::string copyText(const char *text)
+{
+    return text ? std::string(text) : std::string();
+}
+
+static ScanResult::Candidate copyCandidate(const TOneCandidate &oneCandidate)
+{
+    ScanResult::Candidate candidate;
+    candidate.documentName = copyText(oneCandidate.DocumentName);
+    candidate.id = oneCandidate.ID;
+    candidate.probability = oneCandidate.P;
+    candidate.rotated180 = oneCandidate.Rotated180;
+    if(oneCandidate.FDSIDList)
+    {
+        candidate.icaoCode = copyText(oneCandidate.FDSIDList->ICAOCode);
+        candidate.documentType = oneCandidate.FDSIDList->dType;
+        candidate.documentFormat = oneCandidate.FDSIDList->dFormat;
+        candidate.hasMrz = oneCandidate.FDSIDList->dMRZ;
+        candidate.description = copyText(oneCandidate.FDSIDList->dDescription);
+        candidate.year = copyText(oneCandidate.FDSIDList->dYear);
+    }
+    return candidate;
+}
+
+bool DocumentReader::GetScanResult(ScanResult &result)
+{
+    if(!OnSdkThread())
+        return Call([&]() { return GetScanResult(result); });
+    result.clear();
+    if(!passpr40Connected || !CheckResult)
+        return false;
+
+    HANDLE hResult = CachedCheckResult(RPRM_ResultType_OCRLexicalAnalyze, 0, 0);
+    if(reinterpret_cast<intptr_t>(hResult) > 0)
+    {
+        auto lexResult = static_cast<TListVerifiedFields*>((static_cast<TResultContainer*>(hResult))->buffer);
+        if(lexResult && lexResult->Count && lexResult->pFieldMaps)
+        {
+            result.fields.resize(lexResult->Count);
+            for(uint32_t i = 0; i < lexResult->Count; ++i)
+            {
+                const TVerifiedFieldMap &fieldMap = lexResult->pFieldMaps[i];
+                ScanResult::Field &field = result.fields[i];
+                field.fieldType = fieldMap.FieldType;
+                field.lcid = fieldMap.LCID;
+                field.mrz = copyText(fieldMap.Field_MRZ);
+                field.visual = copyText(fieldMap.Field_Visual);
+                field.barcode = copyText(fieldMap.Field_Barcode);
+                field.rfid = copyText(fieldMap.Field_RFID);
+            }
+        }
+    }
+
+    // The MRZ OCR result carries the check results, and stands in for a missing lexical
+    // analysis as in GetTextField().
+    hResult = CachedCheckResult(RPRM_ResultType_MRZ_OCR_Extended, 0, 0);
+    if(reinterpret_cast<intptr_t>(hResult) > 0)
+    {
+        auto mrzResult = static_cast<TDocVisualExtendedInfo*>((static_cast<TResultContainer*>(hResult))->buffer);
+        if(mrzResult && mrzResult->pArrayFields)
+        {
+            size_t lexicalFields = result.fields.size();
+            for(uint32_t i = 0; i < mrzResult->nFields; ++i)
+            {
+                const TDocVisualExtendedField &mrzField = mrzResult->pArrayFields[i];
+                auto first = result.fields.begin();
+                auto last = first + lexicalFields;
+                auto field = std::find_if(first, last, [&mrzField](const ScanResult::Field &f) {
+                    return f.fieldType == static_cast<int>(mrzField.FieldType);
+                });
+                if(field == last)
+                {
+                    result.fields.emplace_back();
+                    field = result.fields.end() - 1;
+                    field->fieldType = mrzField.FieldType;
+                    field->mrz = copyText(mrzField.Buf_Text);
+                }
+                field->validity = mrzField.Validity;
+            }
+        }
+    }
+
+    hResult = CachedCheckResult(RPRM_ResultType_ChosenDocumentTypeCandidate, 0, 0);
+    if(reinterpret_cast<intptr_t>(hResult) > 0)
+    {
+        auto oneCandidate = static_cast<TOneCandidate*>((static_cast<TResultContainer*>(hResult))->buffer);
+        if(oneCandidate)
+        {
+            result.hasCandidate = true;
+            result.candidate = copyCandidate(*oneCandidate);
+        }
+    }
+
+    hResult = CachedCheckResult(RPRM_ResultType_DocumentTypesCandidates, 0, 0);
+    if(reinterpret_cast<intptr_t>(hResult) > 0)
+    {
+        auto candidatesList = static_cast<TCandidatesListContainer*>((static_cast<TResultContainer*>(hResult))->buffer);
+        if(candidatesList && candidatesList->Count && candidatesList->Candidates)
+        {
+            for(uint32_t i = 0; i < candidatesList->Count; ++i)
+            {
+                result.candidates.push_back(copyCandidate(candidatesList->Candidates[i]));
+            }
+        }
+    }
+
+    long graphicsCount = GetReaderResultsCount(RPRM_ResultType_Graphics);
+    for(long i = 0; i < graphicsCount; ++i)
+    {
+        hResult = CachedCheckResult(RPRM_ResultType_Graphics, i, 0);
+        if(reinterpret_cast<intptr_t>(hResult) <= 0)
+            continue;
+
+        auto container = static_cast<TResultContainer*>(hResult);
+        auto graphics = static_cast<TDocGraphicsInfo*>(container->buffer);
+        if(container->result_type != RPRM_ResultType_Graphics || !graphics || !graphics->pArrayFields)
+            continue;
+
+        for(uint32_t j = 0; j < graphics->nFields; ++j)
+        {
+            const TDocGraphicField &graphicField = graphics->pArrayFields[j];
+            ScanResult::Graphic graphic;
+            graphic.container = i;
+            graphic.index = j;
+            graphic.pageIndex = container->page_idx;
+            graphic.fieldType = graphicField.FieldType;
+            graphic.name = GraphicNameFromType(static_cast<eGraphicFieldType>(graphicField.FieldType));
+            graphic.left = graphicField.FieldRect.left;
+            graphic.top = graphicField.FieldRect.top;
+            graphic.right = graphicField.FieldRect.right;
+            graphic.bottom = graphicField.FieldRect.bottom;
+            result.graphics.push_back(graphic);
+        }
+    }
+
+    return !result.fields.empty();
+}
+
+ResultSet &DocumentReader::Results()
+{
+    if(!OnSdkThread())
+        return *Call([this]() { return &Results(); });
+    uint64_t generation = resultGeneration;
+    if(results.generation() != generation)
+    {
+        results.reset(generation);
+        rfidListed = false;
+        ListReaderResults();
+    }
+    if(!rfidListed && rfidRead)
+    {
+        rfidListed = true;
+        ListRfidResults();
+    }
+    return results;
+}
+
+void DocumentReader::ListReaderResults()
+{
+    if(!passpr40Connected || !ResultTypeAvailable)
+        return;
+
+    const std::pair<eRPRM_ResultType, const char*> textResults[] = {
+        { RPRM_ResultType_OCRLexicalAnalyze, "Lex" },
+        { RPRM_ResultType_Authenticity, "Auth" },
+        { RPRM_ResultType_ChosenDocumentTypeCandidate, "DocType" },
+        { RPRM_ResultType_Graphics, "graphic" },
+    };
+    for(const auto &textResult : textResults)
+    {
+        long count = CachedResultsCount(textResult.first);
+        for(long i = 0; i < count; ++i)
+        {
+            ResultSet::Entry entry;
+            entry.kind = ResultSet::Text;
+            entry.label = std::string(textResult.second) + "_" + std::to_string(i);
+            entry.resultType = textResult.first;
+            entry.index = i;
+            results.add(entry, [this](ResultSet::Entry &e) {
+                return ViewReaderResult(static_cast<eRPRM_ResultType>(e.resultType), e.index, e.pageIndex);
+            });
+        }
+    }
+
+    long count = CachedResultsCount(RPRM_ResultType_RawImage);
+    for(long i = 0; i < count; ++i)
+    {
+        // The light is only known from the rendered image.
+        ResultSet::Entry entry;
+        entry.kind = ResultSet::Image;
+        entry.label = "image_" + std::to_string(i);
+        entry.resultType = RPRM_ResultType_RawImage;
+        entry.index = i;
+        results.add(entry, [this](ResultSet::Entry &e) {
+            std::string lightType;
+            ResultView image = ViewReaderResultImage(RPRM_ResultType_RawImage, e.index, lightType, e.pageIndex);
+            if(!lightType.empty())
+                e.label = lightType;
+            return image;
+        });
+    }
+
+    count = CachedResultsCount(RPRM_ResultType_Graphics);
+    for(long i = 0; i < count; ++i)
+    {
+        HANDLE hResult = CachedCheckResult(RPRM_ResultType_Graphics, i, 0);
+        if(reinterpret_cast<intptr_t>(hResult) <= 0)
+            continue;
+
+        auto container = static_cast<TResultContainer*>(hResult);
+        auto graphics = static_cast<TDocGraphicsInfo*>(container->buffer);
+        if(container->result_type != RPRM_ResultType_Graphics || !graphics || !graphics->pArrayFields)
+            continue;
+
+        for(uint32_t j = 0; j < graphics->nFields; ++j)
+        {
+            ResultSet::Entry entry;
+            entry.kind = ResultSet::Graphic;
+            entry.label = GraphicNameFromType(static_cast<eGraphicFieldType>(graphics->pArrayFields[j].FieldType));
+            entry.resultType = RPRM_ResultType_Graphics;
+            entry.index = i;
+            entry.element = j;
+            entry.pageIndex = container->page_idx;
+            results.add(entry, [this](ResultSet::Entry &e) {
+                std::string fieldName;
+                return ViewReaderResultFromList(RPRM_ResultType_Graphics, e.index, e.element, e.pageIndex, fieldName);
+            });
+        }
+    }
+}
+
+void DocumentReader::ListRfidResults()
+{
+    if(!RFIDConnected || !RFID_CheckResult)
+        return;
+
+    HANDLE hResult = RFID_CheckResult(RFID_ResultType_RFID_ImageData, 0, 0);
+    if(reinterpret_cast<intptr_t>(hResult) > 0)
+    {
+        auto container = static_cast<TResultContainer*>(hResult);
+        auto graphics = static_cast<TDocGraphicsInfo*>(container->buffer);
+        if(container->result_type == RFID_ResultType_RFID_ImageData && graphics && graphics->pArrayFields)
+        {
+            for(uint32_t j = 0; j < graphics->nFields; ++j)
+            {
+                ResultSet::Entry entry;
+                entry.kind = ResultSet::RfidImage;
+                entry.label = GraphicNameFromType(static_cast<eGraphicFieldType>(graphics->pArrayFields[j].FieldType));
+                entry.resultType = RFID_ResultType_RFID_ImageData;
+                entry.element = j;
+                results.add(entry, [this](ResultSet::Entry &e) {
+                    std::string fieldName;
+                    return ViewRfidResultFromList(RFID_ResultType_RFID_ImageData, e.element, fieldName);
+                });
+            }
+        }
+    }
+
+    // Without a format the container comes back unrendered.
+    hResult = RFID_CheckResult(RFID_ResultType_RFID_BinaryData, 0, 0);
+    if(reinterpret_cast<intptr_t>(hResult) > 0)
+    {
+        ResultSet::Entry entry;
+        entry.kind = ResultSet::RfidText;
+        entry.label = "RFID binary";
+        entry.resultType = RFID_ResultType_RFID_BinaryData;
+        results.add(entry, [this](ResultSet::Entry &) {
+            return ViewRfidResultXml(RFID_ResultType_RFID_BinaryData);
+        });
+    }
+}
+
 std::string DocumentReader::GetRfidKey()
 {
     std::string result = GetTextField(ft_MRZ_Strings_ICAO_RFID);
@@ -522,21 +1149,33 @@ std::string DocumentReader::GetReaderResult(
     eRPRM_OutputFormat format
 )
 {
+    return ViewReaderResult(resultType, index, pageIndex, format).materializeText();
+}
+
+ResultView DocumentReader::ViewReaderResult(
+    eRPRM_ResultType resultType,
+    long index,
+    long &pageIndex,
+    eRPRM_OutputFormat format
+)
+{
+    if(!OnSdkThread())
+        return Call([&]() { return ViewReaderResult(resultType, index, pageIndex, format); });
     if (enableJson && resultType != eRPRM_ResultType::RPRM_ResultType_Graphics) {
         format = eRPRM_OutputFormat::ofrFormat_JSON;
     }
 
     Q_UNUSED( pageIndex )
-    std::string result;
+    ResultView result;
     if(passpr40Connected)
     {
-        HANDLE resultContainerHandle = CheckResult(resultType, index, format, 0);
-        if((intptr_t)resultContainerHandle >= 0)
+        HANDLE resultContainerHandle = CachedCheckResult(resultType, index, format);
+        if((intptr_t)resultContainerHandle > 0)
         {
             TResultContainer *resContainer = (TResultContainer*)resultContainerHandle;
-            if(resContainer->result_type == resultType)
+            if(resContainer->result_type == resultType && resContainer->XML_buffer)
             {
-                result = (char*)resContainer->XML_buffer;
+                result = ResultView(resContainer->XML_buffer, std::strlen((char*)resContainer->XML_buffer), resultGeneration);
             }
         }
     }
@@ -545,18 +1184,25 @@ std::string DocumentReader::GetReaderResult(
 
 std::vector<uint8_t> DocumentReader::GetReaderResultImage(eRPRM_ResultType resultType, long index, std::string &lightType, long &pageIndex)
 {
-    std::vector<uint8_t> result;
+    return ViewReaderResultImage(resultType, index, lightType, pageIndex).materialize();
+}
+
+ResultView DocumentReader::ViewReaderResultImage(eRPRM_ResultType resultType, long index, std::string &lightType, long &pageIndex)
+{
+    if(!OnSdkThread())
+        return Call([&]() { return ViewReaderResultImage(resultType, index, lightType, pageIndex); });
+    ResultView result;
     if(passpr40Connected)
     {
-        HANDLE resultContainerHandle = CheckResult(resultType, index, ofrFormat_FileBuffer, 0);
-        if((intptr_t)resultContainerHandle >= 0)
+        HANDLE resultContainerHandle = CachedCheckResult(resultType, index, ofrFormat_FileBuffer);
+        if((intptr_t)resultContainerHandle > 0)
         {
             TResultContainer *resContainer = (TResultContainer*)resultContainerHandle;
             if(resContainer->result_type == resultType)
             {
                 pageIndex = resContainer->page_idx;
                 lightType = LightNameFromIndex((eRPRM_Lights)resContainer->light);
-                result = std::vector<uint8_t>((uint8_t*)resContainer->buffer, (uint8_t*)((uintptr_t)resContainer->buffer + resContainer->buf_length));
+                result = ResultView(resContainer->buffer, resContainer->buf_length, resultGeneration);
             }
         }
     }
@@ -565,18 +1211,25 @@ std::vector<uint8_t> DocumentReader::GetReaderResultImage(eRPRM_ResultType resul
 
 std::vector<uint8_t> DocumentReader::GetReaderResultFromList(eRPRM_ResultType resultType, long index, long elementIndex, long &pageIndex, std::string& fieldType)
 {
-    std::vector<uint8_t> result;
+    return ViewReaderResultFromList(resultType, index, elementIndex, pageIndex, fieldType).materialize();
+}
+
+ResultView DocumentReader::ViewReaderResultFromList(eRPRM_ResultType resultType, long index, long elementIndex, long &pageIndex, std::string& fieldType)
+{
+    if(!OnSdkThread())
+        return Call([&]() { return ViewReaderResultFromList(resultType, index, elementIndex, pageIndex, fieldType); });
+    ResultView result;
     if(passpr40Connected)
     {
-        HANDLE resultContainerHandle = CheckResult(resultType, index, 0, 0);
-        if((intptr_t)resultContainerHandle >= 0)
+        HANDLE resultContainerHandle = CachedCheckResult(resultType, index, 0);
+        if((intptr_t)resultContainerHandle > 0)
         {
             TResultContainer *resContainer = (TResultContainer*)resultContainerHandle;
             if(resContainer->result_type == resultType)
             {
                 pageIndex = resContainer->page_idx;
                 long fieldId = 0;
-                result = GetReaderResultFromList(resContainer, elementIndex, fieldId);
+                result = ViewReaderResultFromList(resContainer, elementIndex, fieldId);
                 if((resultType == RPRM_ResultType_Graphics) ||
                         (resultType == RPRM_ResultType_BarCodes_ImageData))
                 {
@@ -590,7 +1243,14 @@ std::vector<uint8_t> DocumentReader::GetReaderResultFromList(eRPRM_ResultType re
 
 std::vector<uint8_t> DocumentReader::GetReaderResultFromList(TResultContainer* resultContainer, long index, long& fieldType)
 {
-    std::vector<uint8_t> result;
+    return ViewReaderResultFromList(resultContainer, index, fieldType).materialize();
+}
+
+ResultView DocumentReader::ViewReaderResultFromList(TResultContainer* resultContainer, long index, long& fieldType)
+{
+    if(!OnSdkThread())
+        return Call([&]() { return ViewReaderResultFromList(resultContainer, index, fieldType); });
+    ResultView result;
     if(passpr40Connected && resultContainer)
     {
         resultContainer->list_idx = index;
@@ -599,7 +1259,7 @@ std::vector<uint8_t> DocumentReader::GetReaderResultFromList(TResultContainer* r
         if(res && resContainer.buf_length && resContainer.buffer)
         {
             fieldType = res;
-            result = std::vector<uint8_t>((uint8_t*)resContainer.buffer, (uint8_t*)((uintptr_t)resContainer.buffer + resContainer.buf_length));
+            result = CachedElement(resultContainer, index, resContainer);
         }
     }
     return result;
@@ -607,17 +1267,24 @@ std::vector<uint8_t> DocumentReader::GetReaderResultFromList(TResultContainer* r
 
 std::string DocumentReader::GetRfidResultXml(eRFID_ResultType resultType)
 {
-    std::string result;
-    if(RFIDConnected && RFID_CheckResult)
+    return ViewRfidResultXml(resultType).materializeText();
+}
+
+ResultView DocumentReader::ViewRfidResultXml(eRFID_ResultType resultType)
+{
+    if(!OnSdkThread())
+        return Call([&]() { return ViewRfidResultXml(resultType); });
+    ResultView result;
+    if(RFIDConnected && RFID_CheckResult && rfidRead)
     {
         HANDLE resultContainerHandle = RFID_CheckResult(resultType, ofXML, 0);
-        if((intptr_t)resultContainerHandle >= 0)
+        if((intptr_t)resultContainerHandle > 0)
         {
             auto resContainer = (TResultContainer*)resultContainerHandle;
             if((resContainer->result_type == resultType) &&
                     resContainer->XML_buffer && resContainer->XML_length)
             {
-                result = reinterpret_cast<char*>(resContainer->XML_buffer);
+                result = ResultView(resContainer->XML_buffer, std::strlen((char*)resContainer->XML_buffer), resultGeneration);
             }
         }
     }
@@ -626,17 +1293,24 @@ std::string DocumentReader::GetRfidResultXml(eRFID_ResultType resultType)
 
 std::vector<uint8_t> DocumentReader::GetRfidResultFromList(eRFID_ResultType resultType, long elementIndex, std::string& fieldType)
 {
-    std::vector<uint8_t> result;
-    if(RFIDConnected && RFID_CheckResult)
+    return ViewRfidResultFromList(resultType, elementIndex, fieldType).materialize();
+}
+
+ResultView DocumentReader::ViewRfidResultFromList(eRFID_ResultType resultType, long elementIndex, std::string& fieldType)
+{
+    if(!OnSdkThread())
+        return Call([&]() { return ViewRfidResultFromList(resultType, elementIndex, fieldType); });
+    ResultView result;
+    if(RFIDConnected && RFID_CheckResult && rfidRead)
     {
         HANDLE resultContainerHandle = RFID_CheckResult(resultType, 0, 0);
-        if((intptr_t)resultContainerHandle >= 0)
+        if((intptr_t)resultContainerHandle > 0)
         {
             auto resContainer = (TResultContainer*)resultContainerHandle;
             if(resContainer->result_type == resultType)
             {
                 long fieldId = 0;
-                result = GetRfidResultFromList(resContainer, elementIndex, fieldId);
+                result = ViewRfidResultFromList(resContainer, elementIndex, fieldId);
                 if(resultType == RFID_ResultType_RFID_ImageData)
                 {
                     fieldType = GraphicNameFromType(static_cast<eGraphicFieldType>(fieldId));
@@ -649,7 +1323,14 @@ std::vector<uint8_t> DocumentReader::GetRfidResultFromList(eRFID_ResultType resu
 
 std::vector<uint8_t> DocumentReader::GetRfidResultFromList(TResultContainer* resultContainer, long index, long& fieldType)
 {
-    std::vector<uint8_t> result;
+    return ViewRfidResultFromList(resultContainer, index, fieldType).materialize();
+}
+
+ResultView DocumentReader::ViewRfidResultFromList(TResultContainer* resultContainer, long index, long& fieldType)
+{
+    if(!OnSdkThread())
+        return Call([&]() { return ViewRfidResultFromList(resultContainer, index, fieldType); });
+    ResultView result;
     if(RFIDConnected && resultContainer && RFID_CheckResultFromList)
     {
         resultContainer->list_idx = index;
@@ -661,7 +1342,7 @@ std::vector<uint8_t> DocumentReader::GetRfidResultFromList(TResultContainer* res
         if(res && resContainer.buf_length && resContainer.buffer)
         {
             fieldType = res;
-            result = std::vector<uint8_t>((uint8_t*)resContainer.buffer, (uint8_t*)((uintptr_t)resContainer.buffer + resContainer.buf_length));
+            result = CachedElement(resultContainer, index, resContainer);
         }
     }
     return result;
@@ -799,3 +1480,12 @@ std::string DocumentReader::GraphicNameFromType(eGraphicFieldType type)
     replace(result, "gf_", "");
     return result;
 }
+
+std::string DocumentReader::RfidFileName(int file)
+{
+    if(file == 0)
+        return "access control";
+    if(file >= dftPassport_DG1 && file <= dftPassport_DG16)
+        return "DG" + std::to_string(file - dftPassport_DG1 + 1);
+    return "file " + std::to_string(file);
+}
@@ -6,73 +6,256 @@
 #include <dlfcn.h>
 #include <PasspR.h>
 #include <RFID.h>
+#include "resultset.h"
+#include "resultview.h"
+#include "rfidprofile.h"
+#include "sdklibrary.h"
+#include "scanresult.h"
 #include <QObject>
 #include <QLibrary>
 #include <QVariant>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
 
 class DocumentReader
 {
+public:
+    enum Stage {
+        StageProcess,           // RPRM_Command_Process
+        StageLexicalAnalysis,   // RPRM_Command_OCRLexicalAnalyze
+        StageRfid,              // RFID scenario
+        StageCount
+    };
+
+    struct ProcessResult {
+        long code = RPRM_Error_NoError;
+        // Stopped by CancelProcess() before `stage`.
+        bool cancelled = false;
+        // `stage` ran past the stage deadline, the following ones were skipped.
+        bool timedOut = false;
+        Stage stage = StageCount;
+        std::array<std::chrono::microseconds, StageCount> timings{};
+        // The chip is still being read, the RFID callback reports the result.
+        bool rfidPending = false;
+    };
+
+    // Time spent on one file of the chip, from the notification that its reading started
+    // to the next one. File 0 is the access control before the first data group, the last
+    // file includes the authentication that follows it.
+    struct RfidTiming {
+        int file = 0;   // eRFID_DataFile_Type
+        std::chrono::microseconds duration{ 0 };
+    };
+
+    struct RfidResult {
+        long code = RFID_Error_NoError;
+        std::chrono::microseconds duration{ 0 };
+        bool timedOut = false;
+        std::vector<RfidTiming> dataGroups;
+    };
+
+    // CheckResult()/ResultTypeAvailable() calls of the current scan answered from the
+    // cache (hits) or by the SDK (misses).
+    struct ResultCacheStats {
+        unsigned long hits = 0;
+        unsigned long misses = 0;
+    };
+
+    using ProcessCallback = std::function<void(const ProcessResult &)>;
+    using RfidCallback = std::function<void(const RfidResult &)>;
+    using NotificationCallback = std::function<void(intptr_t code, intptr_t value)>;
+    using RfidNotificationCallback = std::function<void(int code, void *value)>;
+
+    // Readers that can live in one process, each routes the SDK callbacks of its own
+    // library instance.
+    static const int maxReaders = 4;
 
 private:
-    bool passpr40Connected = false;
+    // Written on the SDK thread, read by IsConnected() & co. from any thread.
+    std::atomic<bool> passpr40Connected{ false };
     QString passpr40LibName = "/usr/lib/regula/sdk/libPasspR40.so";
-    QLibrary passrp40Lib;
+    SdkLibrary passrp40Lib;
+    long deviceIndex = -1;
+    long deviceCount = 0;
 
-    bool hasDocument;
-    _LibraryVersionFunc LibraryVersion;
-    _SetCallbackFuncFunc SetCallbackFunc;
-    _InitializeFunc Initialize;
-    _FreeFunc Free;
-    _ExecuteCommandFunc ExecuteCommand;
-    _CheckResultFunc CheckResult;
+    std::atomic<bool> hasDocument{ false };
+    _LibraryVersionFunc LibraryVersion = nullptr;
+    _SetCallbackFuncFunc SetCallbackFunc = nullptr;
+    _InitializeFunc Initialize = nullptr;
+    _FreeFunc Free = nullptr;
+    _ExecuteCommandFunc ExecuteCommand = nullptr;
+    _CheckResultFunc CheckResult = nullptr;
 
-    _CheckResultFromListFunc CheckResultFromList;
-    _ResultTypeAvailableFunc ResultTypeAvailable;
+    _CheckResultFromListFunc CheckResultFromList = nullptr;
+    _ResultTypeAvailableFunc ResultTypeAvailable = nullptr;
 
-    bool RFIDConnected;
+    std::atomic<bool> RFIDConnected{ false };
+    bool rfidEnabled = false;
     QString RFIDLibName = "/usr/lib/regula/sdk/libRFID_SDK.so";
-    QLibrary RFIDLib;
+    SdkLibrary RFIDLib;
 
     bool hasRfid;
-    rfid::_RFID_LibraryVersion RFID_LibraryVersion;
-    rfid::_RFID_Initialize RFID_Initialize;
-    rfid::_RFID_Free RFID_Free;
-    rfid::_RFID_SetCallbackFunc RFID_SetCallbackFunc;
-    rfid::_RFID_ExecuteCommand RFID_ExecuteCommand;
-    rfid::_RFID_CheckResult RFID_CheckResult;
-    rfid::_RFID_CheckResultFromList RFID_CheckResultFromList;
+    rfid::_RFID_LibraryVersion RFID_LibraryVersion = nullptr;
+    rfid::_RFID_Initialize RFID_Initialize = nullptr;
+    rfid::_RFID_Free RFID_Free = nullptr;
+    rfid::_RFID_SetCallbackFunc RFID_SetCallbackFunc = nullptr;
+    rfid::_RFID_ExecuteCommand RFID_ExecuteCommand = nullptr;
+    rfid::_RFID_CheckResult RFID_CheckResult = nullptr;
+    rfid::_RFID_CheckResultFromList RFID_CheckResultFromList = nullptr;
 
     TRegulaDeviceProperties *deviceProps;
 
-    static DocumentReader *reader;
+    // The SDK callbacks carry no context: every slot has its own set of static callbacks,
+    // which forward to the reader registered in it.
+    static std::array<std::atomic<DocumentReader*>, maxReaders> readers;
+    int slot = -1;
+    struct SlotCallbacks {
+        ResultReceivingFunc result;
+        NotifyFunc notify;
+        RFID_NotifyFunc rfid;
+    };
+    static const SlotCallbacks slotCallbacks[maxReaders];
+
+    template<int Slot> static void ResultReceivingCallback(TResultContainer *result, uint32_t *PostAction, uint32_t *PostActionParameter);
+    template<int Slot> static void NotifyCallback(intptr_t code, intptr_t value);
+    template<int Slot> static void RFID_NotifyCallback(int code, void *value);
+    void OnNotification(intptr_t code, intptr_t value);
+    void OnRfidNotification(int code, void *value);
+    NotificationCallback notificationCallback;
+    RfidNotificationCallback rfidNotificationCallback;
+
+    // SDK jobs, ProcessAsync() and the calls routed through Call(), run one at a time on a
+    // thread started on first use. Processing requests up to cancelledSerial are cancelled.
+    std::thread sdkThread;
+    std::mutex jobsMutex;
+    std::condition_variable jobsChanged;
+    std::deque<std::function<void()>> jobs;
+    bool stopping = false;
+    std::atomic<uint64_t> processSerial;
+    std::atomic<uint64_t> cancelledSerial;
+    std::atomic<long> stageDeadline;
 
-    static void ResultReceivingCallback(TResultContainer *result, uint32_t *PostAction, uint32_t *PostActionParameter);
-    static void NotifyCallback(intptr_t code, intptr_t value);
-    static NotifyFunc notificationCallback;
+    void sdkLoop();
+    long RunStages(intptr_t processingMode, uint64_t serial, ProcessResult &result, RfidCallback rfidCallback);
 
-    static void RFID_NotifyCallback(int code, void *value);
-    static RFID_NotifyFunc rfidNotificationCallback;
+    // Containers handed out by CheckResult(), rendered buffers included, keyed by
+    // (type, index, format). They stay valid until the next Process(), which starts a new
+    // generation; ResultViews are stamped with the same counter.
+    struct CachedResult {
+        uint64_t generation = 0;
+        HANDLE handle = nullptr;
+        long count = 0;
+    };
+    std::mutex cacheMutex;
+    std::map<std::tuple<long, long, long>, CachedResult> resultCache;
+    // Elements of list results, keyed by (container, element). CheckResultFromList() renders
+    // into a buffer it may reuse for the next element, the views get a copy that is dropped
+    // with the generation.
+    std::map<std::pair<HANDLE, long>, std::vector<uint8_t>> elementCache;
+    std::atomic<uint64_t> resultGeneration;
+    ResultCacheStats resultCacheStats;
+
+    void Post(std::function<void()> job);
+    // Runs `job` on the SDK thread and waits for its result. Inline on the SDK thread itself,
+    // and once the thread has stopped (the destructor).
+    template<typename Job> auto Call(Job job) -> decltype(job());
+    bool OnSdkThread();
+    void InvalidateResults();
+    HANDLE CachedCheckResult(long resultType, long index, long format);
+    ResultView CachedElement(HANDLE container, long index, const TResultContainer &element);
+    long CachedResultsCount(long resultType);
+
+    // Listed by Results() once per generation, the RFID part once the chip has been read.
+    ResultSet results;
+    bool rfidListed = false;
+    std::atomic<bool> rfidRead;
+
+    void ListReaderResults();
+    void ListRfidResults();
+
+    // Pipelined chip read started by RunStages(), joined before the next one.
+    std::thread rfidThread;
+
+    // Profiles are compiled by ConnectRFID(), the timings are filled in by the RFID
+    // notifications of the running read.
+    std::mutex rfidMutex;
+    QString rfidProfilesPath;
+    RfidProfiles rfidProfiles;
+    std::string rfidProfileName = "default";
+    std::vector<RfidTiming> rfidTimings;
+    int rfidFile = -1;
+    std::chrono::steady_clock::time_point rfidFileStarted;
+
+    void LoadRfidProfiles();
+    void MarkRfidFile(int file);
+    int ReadRfid(const std::string &rfidKey);
+    void RfidLoop(std::string rfidKey, RfidCallback callback, long deadline);
+    void WaitForRfid();
 
 public:
+    // Every call below that reaches the SDK runs on the reader's SDK thread, the calling
+    // thread waits for it. The one exception is the pipelined chip read of ProcessAsync(),
+    // which runs RFID_Command_Scenario_Process on the RFID thread while the SDK thread goes
+    // on serving PasspR calls. The RFID library has one user at a time all the same: the
+    // RFID getters return nothing until the read is over, and the next scan, ConnectRFID()
+    // and Disconnect() wait for it.
     DocumentReader();
     ~DocumentReader();
     bool IsConnected();
     bool IsRFIDConnected();
     bool HasDocument();
     long Connect(const std::string name);
+    // Connect() on the SDK thread, which then owns the device.
+    std::future<long> ConnectAsync(const std::string name);
     long ConnectPasspr();
     long ConnectRFID();
     long Disconnect();
     long DisconnectPasspr();
     long DisconnectRfid();
     long Process(intptr_t processingMode);
+    // Runs Process() on the SDK thread and returns immediately. The callback (if any) runs
+    // on the SDK thread; other SDK calls queue up behind it.
+    // With an RFID callback the chip is read on a thread of its own as soon as lexical
+    // analysis has produced the MRZ key: the result comes back with rfidPending set and
+    // PasspR results can be read while the RFID callback, which runs on the RFID thread after
+    // the processing callback, is still to come. RFID results must wait for it.
+    std::future<ProcessResult> ProcessAsync(intptr_t processingMode, ProcessCallback callback = nullptr, RfidCallback rfidCallback = nullptr);
+    // Stops every queued or running ProcessAsync() before its next stage.
+    void CancelProcess();
+    // SDK calls cannot be interrupted, a stage running longer than `deadline` ends the
+    // processing once it returns. Zero disables the deadline.
+    void SetStageDeadline(std::chrono::milliseconds deadline);
+    // INI file with the RFID profiles (see rfidprofile.h), read on the next ConnectRFID().
+    void SetRfidProfiles(const QString &path) { rfidProfilesPath = path; }
+    // Profile of the following chip reads; unknown names read with "default".
+    void SetRfidProfile(const std::string &name);
+    // Per-file timings of the last chip read.
+    std::vector<RfidTiming> GetRfidTimings();
     long Calibrate();
+    // Calibrate() on the SDK thread, the callback (if any) runs there once it is done. The
+    // calibration step notifications come from that thread and may hold it until the object
+    // is in place; the caller must not wait for the SDK meanwhile.
+    std::future<long> CalibrateAsync(std::function<void(long)> callback = nullptr);
     long SetAuthenticityChecks(intptr_t authCheckMode);
     long GetReaderResultsCount(eRPRM_ResultType resultType);
+    ResultCacheStats GetResultCacheStats();
     std::string GetTextField(const eVisualFieldType fieldType);
     std::string GetTextField(const std::vector<eVisualFieldType>& fieldType);
     std::string GetRfidKey();
+    bool GetScanResult(ScanResult &result);
+    // Every result of the current scan, fetched when first asked for. The RFID entries
+    // are added by the first call after the chip read has finished.
+    ResultSet &Results();
     std::string GetReaderResult(eRPRM_ResultType resultType, long index, long &pageIndex, eRPRM_OutputFormat format = eRPRM_OutputFormat::ofrFormat_XML);
     std::vector<uint8_t> GetReaderResultImage(eRPRM_ResultType resultType, long index, std::string &lightType, long &pageIndex);
     std::vector<uint8_t> GetReaderResultFromList(eRPRM_ResultType resultType, long index, long elementIndex, long &pageIndex, std::string& fieldType);
@@ -80,9 +263,32 @@ public:
     std::string GetRfidResultXml(eRFID_ResultType resultType);
     std::vector<uint8_t> GetRfidResultFromList(eRFID_ResultType resultType, long elementIndex, std::string& fieldType);
     std::vector<uint8_t> GetRfidResultFromList(TResultContainer* resultContainer, long index, long& fieldType);
+    // Same as the Get* calls above, without the copy. The views point into the SDK's
+    // containers, list elements into the reader's copy of them, and go stale when the next
+    // Process() starts.
+    ResultView ViewReaderResult(eRPRM_ResultType resultType, long index, long &pageIndex, eRPRM_OutputFormat format = eRPRM_OutputFormat::ofrFormat_XML);
+    ResultView ViewReaderResultImage(eRPRM_ResultType resultType, long index, std::string &lightType, long &pageIndex);
+    ResultView ViewReaderResultFromList(eRPRM_ResultType resultType, long index, long elementIndex, long &pageIndex, std::string& fieldType);
+    ResultView ViewReaderResultFromList(TResultContainer* resultContainer, long index, long& fieldType);
+    ResultView ViewRfidResultXml(eRFID_ResultType resultType);
+    ResultView ViewRfidResultFromList(eRFID_ResultType resultType, long elementIndex, std::string& fieldType);
+    ResultView ViewRfidResultFromList(TResultContainer* resultContainer, long index, long& fieldType);
     static std::string LightNameFromIndex(eRPRM_Lights light);
     static std::string GraphicNameFromType(eGraphicFieldType type);
-    void SetNotificationCallback(NotifyFunc notificationFunction) { notificationCallback = notificationFunction; }
+    static std::string RfidFileName(int file);
+    // Both run on SDK threads.
+    void SetNotificationCallback(NotificationCallback notificationFunction) { notificationCallback = notificationFunction; }
+    void SetRfidNotificationCallback(RfidNotificationCallback notificationFunction) { rfidNotificationCallback = notificationFunction; }
+    // Must be set before Connect(), e.g. to load a stub library.
+    void SetPasspr40LibName(const QString &name) { passpr40LibName = name; }
+    // Must be set before Connect(). Disabled (the default), ConnectRFID() loads and initializes
+    // the RFID library but connects no reader, so no chip is read.
+    void SetRfidEnabled(bool enabled) { rfidEnabled = enabled; }
+    // Must be set before Connect(); -1 connects the first free device.
+    void SetDeviceIndex(long index) { deviceIndex = index; }
+    long GetDeviceIndex() const { return deviceIndex; }
+    // Devices the SDK reported on the last Connect().
+    long GetDeviceCount() const { return deviceCount; }
 
     std::function<void(TResultContainer*)> VdCallback;
     bool enableVd = false;
@@ -93,4 +299,15 @@ public:
     std::string getDeviceInfo();
 };
 
+template<typename Job>
+auto DocumentReader::Call(Job job) -> decltype(job())
+{
+    if(OnSdkThread())
+        return job();
+    auto task = std::make_shared<std::packaged_task<decltype(job())()>>(std::move(job));
+    auto result = task->get_future();
+    Post([task]() { (*task)(); });
+    return result.get();
+}
+
 #endif // DOCUMENTREADER_H
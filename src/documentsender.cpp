@@ -1,55 +1,864 @@
 #include "documentsender.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <sstream>
 
-DocumentSender::DocumentSender() {
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+DocumentSender::DocumentSender() :
+    DocumentSender(PoolOptions())
+{
+}
+
+DocumentSender::DocumentSender(PoolOptions options) :
+    poolOptions(options),
+    running(true),
+    outstanding(0),
+    reusedConnections(0),
+    openedConnections(0),
+    jitter(std::random_device()()),
+    compressionCodec(DocumentCompressor::None),
+    compressionLevel(0),
+    compressionThreshold(1024),
+    acceptedEncodings(0),
+    batchLimit(0),
+    batchWindow(0),
+    lanesEnabled(false),
+    bulkSendSpeed(0),
+    bulkConcurrency(1),
+    dedupEnabled(false),
+    dedupMinSize(4096),
+    dedupLookups(0),
+    dedupHits(0),
+    dedupRejected(0),
+    dedupSaved(0)
+{
+    for (auto &counter : statusClasses) {
+        counter = 0;
+    }
+
+    share = curl_share_init();
+    if (share) {
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, &DocumentSender::lockShare);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, &DocumentSender::unlockShare);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    }
+
+    multi = curl_multi_init();
+    if (multi) {
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, poolOptions.maxHostConnections);
+        ioThread = std::thread(&DocumentSender::ioLoop, this);
+    } else {
+        qDebug() << "curl_multi_init() failed";
     }
 }
 
 DocumentSender::~DocumentSender() {
-    curl_mime_free(mime);
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+    running = false;
+    if (ioThread.joinable()) {
+        curl_multi_wakeup(multi);
+        ioThread.join();
+    }
+
+    Result aborted;
+    aborted.code = CURLE_ABORTED_BY_CALLBACK;
+    aborted.error = "sender is shutting down";
+
+    for (auto &request : openBatch) {
+        complete(std::move(request), aborted);
+    }
+    openBatch.clear();
+    for (auto &request : bulkQueue) {
+        complete(std::move(request), aborted);
+    }
+    bulkQueue.clear();
+
+    while (!inFlight.empty()) {
+        CURL *easy = inFlight.begin()->first;
+        auto request = std::move(inFlight.begin()->second);
+        inFlight.erase(inFlight.begin());
+        curl_multi_remove_handle(multi, easy);
+        complete(std::move(request), aborted);
+    }
+
+    // Uploads the I/O thread never took are journaled now, so the next start sends them.
+    std::deque<std::unique_ptr<Request>> left;
+    std::shared_ptr<DocumentOutbox> journal;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        left.swap(pending);
+        journal = outbox;
+    }
+    if (journal) {
+        for (auto &request : left) {
+            journalRequest(*journal, *request);
+        }
+        journal->sync();
+    }
+    for (auto &request : left) {
+        complete(std::move(request), aborted);
+    }
+
+    for (auto easy : idleHandles) {
+        curl_easy_cleanup(easy);
+    }
+    idleHandles.clear();
+
+    curl_multi_cleanup(multi);
+    curl_share_cleanup(share);
+}
+
+void DocumentSender::lockShare(CURL *, curl_lock_data data, curl_lock_access, void *userptr) {
+    static_cast<DocumentSender *>(userptr)->shareLocks[data].lock();
+}
+
+void DocumentSender::unlockShare(CURL *, curl_lock_data data, void *userptr) {
+    static_cast<DocumentSender *>(userptr)->shareLocks[data].unlock();
+}
+
+CURL *DocumentSender::acquireHandle() {
+    if (!idleHandles.empty()) {
+        CURL *easy = idleHandles.back();
+        idleHandles.pop_back();
+        return easy;
+    }
+
+    CURL *easy = curl_easy_init();
+    if (easy) {
+        curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(easy, CURLOPT_MAXAGE_CONN, poolOptions.idleTimeout);
+        curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, &DocumentSender::readHeader);
+        if (share) {
+            curl_easy_setopt(easy, CURLOPT_SHARE, share);
+        }
+    }
+    return easy;
+}
+
+void DocumentSender::releaseHandle(CURL *easy) {
+    if (!easy) {
+        return;
+    }
+
+    // Drop references to per-request data, keep the handle and its connection cache.
+    curl_easy_setopt(easy, CURLOPT_MIMEPOST, nullptr);
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, nullptr);
+    curl_easy_setopt(easy, CURLOPT_HEADERDATA, nullptr);
+
+    if (idleHandles.size() < poolOptions.maxIdleHandles) {
+        idleHandles.push_back(easy);
+    } else {
+        curl_easy_cleanup(easy);
+    }
+}
+
+void DocumentSender::ioLoop() {
+    int appliedCodec = DocumentCompressor::None;
+    int appliedLevel = 0;
+
+    while (running) {
+        std::deque<std::unique_ptr<Request>> incoming;
+        std::shared_ptr<DocumentOutbox> journal;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            incoming.swap(pending);
+            journal = outbox;
+            replayQueue.insert(replayQueue.end(), recovered.begin(), recovered.end());
+            recovered.clear();
+        }
+        if (compressionCodec != appliedCodec || compressionLevel != appliedLevel) {
+            appliedCodec = compressionCodec;
+            appliedLevel = compressionLevel;
+            compressor.setCodec(static_cast<DocumentCompressor::Codec>(appliedCodec), appliedLevel);
+        }
+        for (auto &request : incoming) {
+            // Journaled here rather than in enqueue(), which runs on the caller's thread.
+            if (journal) {
+                journalRequest(*journal, *request);
+            }
+            if (batchLimit > 1 && request->lane != Lane::High) {
+                addToBatch(std::move(request));
+            } else {
+                dispatch(std::move(request));
+            }
+        }
+        if (!openBatch.empty() && (batchLimit <= 1 || std::chrono::steady_clock::now() >= batchDeadline)) {
+            flushBatch();
+        }
+        startBulk();
+        if (journal) {
+            replay(*journal);
+        }
+
+        int stillRunning = 0;
+        CURLMcode mc = curl_multi_perform(multi, &stillRunning);
+        if (mc != CURLM_OK) {
+            qDebug() << "curl_multi_perform() failed:" << curl_multi_strerror(mc);
+        }
+
+        CURLMsg *msg = nullptr;
+        int msgsLeft = 0;
+        while ((msg = curl_multi_info_read(multi, &msgsLeft))) {
+            if (msg->msg == CURLMSG_DONE) {
+                finishRequest(msg->easy_handle, msg->data.result);
+            }
+        }
+        startBulk();
+
+        if (journal) {
+            journal->maybeSync();
+        }
+
+        // Sleeps until a socket is ready, a timeout expires or enqueue() wakes us up.
+        curl_multi_poll(multi, nullptr, 0, pollTimeout(journal != nullptr), nullptr);
+    }
+}
+
+int DocumentSender::pollTimeout(bool hasJournal) {
+    auto now = std::chrono::steady_clock::now();
+    auto until = [&now](std::chrono::steady_clock::time_point due) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count();
+        return static_cast<int>(std::max<long long>(0, left));
+    };
+
+    // Wake up in time for batched syncs, the next scheduled retry and the batch deadline.
+    int timeout = hasJournal ? 200 : 1000;
+    if (!delayed.empty()) {
+        timeout = std::min(timeout, until(delayed.begin()->first));
+    }
+    if (!openBatch.empty()) {
+        timeout = std::min(timeout, until(batchDeadline));
+    }
+    return timeout;
+}
+
+void DocumentSender::addToBatch(std::unique_ptr<Request> request) {
+    if (!openBatch.empty()) {
+        auto &first = openBatch.front();
+        if (first->url != request->url || first->headers != request->headers || first->lane != request->lane) {
+            flushBatch();
+        }
+    }
+
+    if (openBatch.empty()) {
+        batchDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(batchWindow.load());
+    }
+    openBatch.push_back(std::move(request));
+
+    if (openBatch.size() >= batchLimit) {
+        flushBatch();
+    }
+}
+
+void DocumentSender::flushBatch() {
+    if (openBatch.empty()) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        ++batchCounters.batches;
+        for (auto &member : openBatch) {
+            auto wait = std::chrono::duration_cast<std::chrono::microseconds>(now - member->enqueuedAt);
+            ++batchCounters.scans;
+            batchCounters.totalWait += wait;
+            batchCounters.maxWait = std::max(batchCounters.maxWait, wait);
+        }
+    }
+
+    std::vector<std::unique_ptr<Request>> members;
+    members.swap(openBatch);
+
+    if (members.size() == 1) {
+        dispatch(std::move(members.front()));
+        return;
+    }
+
+    std::unique_ptr<Request> batch(new Request);
+    batch->url = members.front()->url;
+    batch->headers = members.front()->headers;
+    batch->lane = members.front()->lane;
+    batch->notified = true;
+    batch->enqueuedAt = now;
+
+    Mime count{ "batch", std::to_string(members.size()), false };
+    batch->parts.push_back(std::move(count));
+    for (size_t i = 0; i < members.size(); ++i) {
+        std::string suffix = "[" + std::to_string(i) + "]";
+        for (auto &m : members[i]->parts) {
+            // Part data stays where it is, the batch only borrows it from its members.
+            Mime part{ m.name + suffix, m.isFile ? m.value : "", m.isFile };
+            if (!m.isFile) {
+                part.data = m.data ? m.data : reinterpret_cast<const uint8_t *>(m.value.data());
+                part.size = m.data ? m.size : m.value.size();
+            }
+            part.filename = m.filename;
+            part.type = m.type;
+            batch->parts.push_back(std::move(part));
+        }
+    }
+    batch->members = std::move(members);
+
+    dispatch(std::move(batch));
+}
+
+void DocumentSender::dispatch(std::unique_ptr<Request> request) {
+    if (request->lane == Lane::Bulk) {
+        bulkQueue.push_back(std::move(request));
+    } else {
+        startRequest(std::move(request));
+    }
+}
+
+void DocumentSender::startBulk() {
+    unsigned active = 0;
+    for (auto &transfer : inFlight) {
+        if (transfer.second->lane == Lane::Bulk) {
+            ++active;
+        }
+    }
+
+    while (!bulkQueue.empty() && active < std::max(1u, bulkConcurrency.load())) {
+        auto request = std::move(bulkQueue.front());
+        bulkQueue.pop_front();
+        startRequest(std::move(request));
+        ++active;
+    }
+}
+
+std::vector<std::unique_ptr<DocumentSender::Request>> DocumentSender::splitByLane(std::unique_ptr<Request> &scan) {
+    std::vector<std::unique_ptr<Request>> lanes;
+
+    auto isBulk = [](const Mime &m) {
+        return m.isFile || !m.filename.empty();
+    };
+    size_t bulkParts = std::count_if(scan->parts.begin(), scan->parts.end(), isBulk);
+    if (bulkParts == 0 || bulkParts == scan->parts.size()) {
+        return lanes;
+    }
+
+    static std::atomic<unsigned long> scanCounter(0);
+    std::string scanId = std::to_string(std::chrono::system_clock::now().time_since_epoch().count())
+        + "-" + std::to_string(++scanCounter);
+
+    auto group = std::make_shared<LaneGroup>();
+    group->promise = std::move(scan->promise);
+    group->callback = std::move(scan->callback);
+    group->remaining = 2;
+
+    std::unique_ptr<Request> metadata(new Request);
+    std::unique_ptr<Request> bulk(new Request);
+    metadata->lane = Lane::High;
+    bulk->lane = Lane::Bulk;
+
+    for (auto request : { metadata.get(), bulk.get() }) {
+        request->url = scan->url;
+        request->headers = scan->headers;
+        request->enqueuedAt = scan->enqueuedAt;
+        request->createdAt = scan->createdAt;
+        request->group = group;
+        request->parts.push_back(Mime{ "scanId", scanId, false });
+    }
+    for (auto &m : scan->parts) {
+        (isBulk(m) ? bulk : metadata)->parts.push_back(std::move(m));
+    }
+
+    lanes.push_back(std::move(metadata));
+    lanes.push_back(std::move(bulk));
+    return lanes;
+}
+
+void DocumentSender::replay(DocumentOutbox &journal) {
+    auto now = std::chrono::steady_clock::now();
+    while (!delayed.empty() && delayed.begin()->first <= now) {
+        replayQueue.push_back(delayed.begin()->second);
+        delayed.erase(delayed.begin());
+    }
+
+    // Replayed uploads are read back from the journal only when a transfer slot is free.
+    size_t window = static_cast<size_t>(std::max(1L, poolOptions.maxHostConnections)) * 2;
+    while (!replayQueue.empty() && inFlight.size() + bulkQueue.size() < window) {
+        uint64_t id = replayQueue.front();
+        replayQueue.pop_front();
+
+        DocumentOutbox::Upload upload;
+        if (!journal.load(id, upload)) {
+            attempts.erase(id);
+            continue;
+        }
+
+        std::unique_ptr<Request> request(new Request);
+        request->url = upload.url;
+        request->headers = upload.headers;
+        request->journalId = id;
+        request->createdAt = upload.createdAt;
+        request->lane = static_cast<Lane>(upload.lane);
+        request->notified = true;
+        for (auto &part : upload.parts) {
+            Mime m{ part.name, "", part.isFile };
+            if (part.isFile) {
+                m.value.assign(reinterpret_cast<const char *>(part.data), part.size);
+            } else {
+                m.buffer = upload.storage;
+                m.data = part.data;
+                m.size = part.size;
+            }
+            m.filename = part.filename;
+            m.type = part.type;
+            request->parts.push_back(std::move(m));
+        }
+
+        // Bulk halves go back to the bulk queue and its rate and concurrency limits.
+        ++outstanding;
+        dispatch(std::move(request));
+    }
+}
+
+std::chrono::milliseconds DocumentSender::nextDelay() {
+    // Exponential backoff with equal jitter: half of the delay is fixed, half is random.
+    unsigned shift = std::min(consecutiveFailures, 16u);
+    auto ceiling = std::min(retryOptions.maxDelay, retryOptions.baseDelay * (1L << shift));
+    std::uniform_int_distribution<long> spread(0, ceiling.count() / 2);
+    return std::chrono::milliseconds(ceiling.count() / 2 + spread(jitter));
 }
 
-void DocumentSender::setUpMime() {
-    if (mime) {
-        curl_mime_free(mime);
+void DocumentSender::startRequest(std::unique_ptr<Request> request) {
+    request->easy = acquireHandle();
+    if (!request->easy) {
+        Result failed;
+        failed.code = CURLE_FAILED_INIT;
+        failed.error = "curl_easy_init() failed";
+        complete(std::move(request), failed);
+        return;
     }
 
-    mime = curl_mime_init(curl);
-    for (auto m : preparedMime) {
-        part = curl_mime_addpart(mime);
+    CURL *easy = request->easy;
+    curl_easy_setopt(easy, CURLOPT_CUSTOMREQUEST, "POST");
+    curl_easy_setopt(easy, CURLOPT_MAX_SEND_SPEED_LARGE,
+        static_cast<curl_off_t>(request->lane == Lane::Bulk ? bulkSendSpeed.load() : 0));
+    curl_easy_setopt(easy, CURLOPT_URL, request->url.c_str());
+    curl_easy_setopt(easy, CURLOPT_HEADERDATA, request.get());
+
+    for (auto &value : request->headers) {
+        request->headerList = curl_slist_append(request->headerList, value.c_str());
+    }
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, request->headerList);
+
+    request->mime = curl_mime_init(easy);
+    for (auto &m : request->parts) {
+        curl_mimepart *part = curl_mime_addpart(request->mime);
         curl_mime_name(part, m.name.c_str());
 
         if (m.isFile) {
             curl_mime_filedata(part, m.value.c_str());
+            continue;
+        }
+
+        if (!m.filename.empty()) {
+            curl_mime_filename(part, m.filename.c_str());
+        }
+        if (!m.type.empty()) {
+            curl_mime_type(part, m.type.c_str());
+        }
+
+        if (deduplicate(*request, part, m)) {
+            continue;
+        }
+
+        PartReader reader;
+        if (m.data) {
+            reader = PartReader{ reinterpret_cast<const char *>(m.data), m.size, 0 };
         } else {
-            curl_mime_data(part, m.value.c_str(), CURL_ZERO_TERMINATED);
+            reader = PartReader{ m.value.data(), m.value.size(), 0 };
+        }
+
+        // Only text parts are worth it, named file buffers are already encoded images.
+        if (m.filename.empty() && compressor.currentCodec() != DocumentCompressor::None
+                && (acceptedEncodings & (1u << compressor.currentCodec())) && reader.size >= compressionThreshold) {
+            request->compressed.emplace_back();
+            auto &packed = request->compressed.back();
+            if (compressor.compress(reinterpret_cast<const uint8_t *>(reader.data), reader.size, packed)
+                    && packed.size() < reader.size) {
+                reader = PartReader{ reinterpret_cast<const char *>(packed.data()), packed.size(), 0 };
+                std::string encoding = std::string("Content-Encoding: ") + DocumentCompressor::encodingName(compressor.currentCodec());
+                curl_mime_headers(part, curl_slist_append(nullptr, encoding.c_str()), 1);
+            } else {
+                request->compressed.pop_back();
+            }
         }
+
+        request->readers.push_back(reader);
+        curl_mime_data_cb(part, reader.size, &DocumentSender::readPart, &DocumentSender::seekPart, nullptr, &request->readers.back());
     }
-    curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
+    curl_easy_setopt(easy, CURLOPT_MIMEPOST, request->mime);
+
+    CURLMcode mc = curl_multi_add_handle(multi, easy);
+    if (mc != CURLM_OK) {
+        Result failed;
+        failed.code = CURLE_FAILED_INIT;
+        failed.error = curl_multi_strerror(mc);
+        complete(std::move(request), failed);
+        return;
+    }
+
+    inFlight[easy] = std::move(request);
 }
 
-void DocumentSender::setHeaders(std::vector<std::string> &h) {
-    if (headers) {
-        curl_slist_free_all(headers);
+bool DocumentSender::deduplicate(Request &request, curl_mimepart *part, const Mime &m) {
+    if (!dedupEnabled || request.fullContent || m.filename.empty() || !m.data || m.size < dedupMinSize) {
+        return false;
+    }
+
+    std::string digest = DigestCache::hash(m.data, m.size);
+    bool known;
+    {
+        std::lock_guard<std::mutex> lock(dedupMutex);
+        known = digests.touch(digest);
     }
+    ++dedupLookups;
 
-    for (auto value : h) {
-        curl_slist_append(headers, value.c_str());
+    std::string header = (known ? "X-Content-Ref: " : "X-Content-Digest: ") + digest;
+    curl_mime_headers(part, curl_slist_append(nullptr, header.c_str()), 1);
+    if (!known) {
+        request.digests.push_back(digest);
+        return false;
     }
+
+    ++dedupHits;
+    request.references.push_back(digest);
+    request.referencedBytes += m.size;
+    curl_mime_data(part, "", 0);
+    return true;
+}
+
+void DocumentSender::finishRequest(CURL *easy, CURLcode code) {
+    auto it = inFlight.find(easy);
+    if (it == inFlight.end()) {
+        return;
+    }
+
+    auto request = std::move(it->second);
+    inFlight.erase(it);
+    curl_multi_remove_handle(multi, easy);
+
+    Result result;
+    result.code = code;
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &result.httpStatus);
+    recordTimings(easy, result);
+
+    long newConnections = 0;
+    if (curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &newConnections) == CURLE_OK) {
+        if (newConnections > 0) {
+            openedConnections += newConnections;
+        } else if (code == CURLE_OK) {
+            ++reusedConnections;
+        }
+    }
+    if (code != CURLE_OK) {
+        result.error = curl_easy_strerror(code);
+        qDebug() << "upload to" << request->url.c_str() << "failed:" << result.error.c_str();
+    }
+
+    if (request->acceptEncoding >= 0) {
+        acceptedEncodings = static_cast<unsigned>(request->acceptEncoding);
+    }
+    if (code == CURLE_OK && result.httpStatus == 415 && !request->compressed.empty()) {
+        qDebug() << "server does not accept compressed parts, sending them uncompressed";
+        acceptedEncodings = 0;
+        releaseTransfer(*request);
+        request->digests.clear();
+        request->references.clear();
+        request->referencedBytes = 0;
+        startRequest(std::move(request));
+        return;
+    }
+
+    if (code == CURLE_OK && result.httpStatus == 409 && !request->references.empty()) {
+        qDebug() << "server does not know" << request->references.size() << "referenced parts, sending them in full";
+        {
+            std::lock_guard<std::mutex> lock(dedupMutex);
+            for (const auto &digest : request->references) {
+                digests.erase(digest);
+            }
+        }
+        dedupRejected += request->references.size();
+        releaseTransfer(*request);
+        request->digests.clear();
+        request->references.clear();
+        request->referencedBytes = 0;
+        request->fullContent = true;
+        startRequest(std::move(request));
+        return;
+    }
+
+    complete(std::move(request), result);
+}
+
+void DocumentSender::recordTimings(CURL *easy, Result &result) {
+    curl_off_t dns = 0, connect = 0, tls = 0, pretransfer = 0, posttransfer = 0, firstByte = 0, total = 0;
+    curl_easy_getinfo(easy, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+    curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(easy, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(easy, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+    curl_easy_getinfo(easy, CURLINFO_STARTTRANSFER_TIME_T, &firstByte);
+    curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME_T, &total);
+#if LIBCURL_VERSION_NUM >= 0x080a00
+    curl_easy_getinfo(easy, CURLINFO_POSTTRANSFER_TIME_T, &posttransfer);
+#endif
+    curl_easy_getinfo(easy, CURLINFO_SIZE_UPLOAD_T, &result.timings.bytesSent);
+
+    // curl reports cumulative times from the start of the transfer; keep per-phase deltas.
+    // A reused connection reports zero for the phases it skipped.
+    auto delta = [](curl_off_t to, curl_off_t from) {
+        return std::chrono::microseconds(to > from ? to - from : 0);
+    };
+    curl_off_t connected = std::max(dns, connect);
+    curl_off_t secured = tls ? std::max(connected, tls) : connected;
+    curl_off_t started = std::max(secured, pretransfer);
+    // For uploads curl stamps the start of the transfer when the body starts going out,
+    // so the server wait is measured from the last byte sent. Without CURLINFO_POSTTRANSFER
+    // (curl < 8.10) the upload can not be told apart and is counted as server wait.
+    curl_off_t sent = posttransfer > started ? posttransfer : started;
+    curl_off_t answered = posttransfer && firstByte > sent ? firstByte : total;
+
+    auto &phases = result.timings.phases;
+    phases[PhaseDns] = std::chrono::microseconds(dns);
+    phases[PhaseConnect] = delta(connect, dns);
+    phases[PhaseTls] = tls ? delta(tls, connected) : std::chrono::microseconds(0);
+    phases[PhasePretransfer] = delta(pretransfer, secured);
+    phases[PhaseUpload] = delta(sent, started);
+    phases[PhaseFirstByte] = delta(answered, sent);
+    phases[PhaseTotal] = std::chrono::microseconds(total);
+
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        phaseHistograms[phase].record(static_cast<uint64_t>(phases[phase].count()));
+    }
+    sentBytes.record(static_cast<uint64_t>(result.timings.bytesSent));
+
+    long statusClass = result.httpStatus / 100;
+    ++statusClasses[statusClass >= 1 && statusClass <= 5 ? statusClass : 0];
+}
+
+void DocumentSender::complete(std::unique_ptr<Request> request, Result result) {
+    releaseTransfer(*request);
+
+    if (result.ok() && (!request->digests.empty() || request->referencedBytes)) {
+        std::lock_guard<std::mutex> lock(dedupMutex);
+        for (const auto &digest : request->digests) {
+            digests.insert(digest);
+        }
+        dedupSaved += request->referencedBytes;
+    }
+
+    std::vector<Request *> scans;
+    if (request->members.empty()) {
+        scans.push_back(request.get());
+    } else {
+        for (auto &member : request->members) {
+            scans.push_back(member.get());
+        }
+    }
+
+    std::shared_ptr<DocumentOutbox> journal;
+    if (running) {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        journal = outbox;
+    }
+
+    bool retryable = result.code != CURLE_OK || result.httpStatus >= 500
+        || result.httpStatus == 408 || result.httpStatus == 429;
+    if (journal && retryable) {
+        ++consecutiveFailures;
+    }
+
+    for (auto scan : scans) {
+        Result scanResult = result;
+        if (!running && scan->journalId) {
+            // Aborted by the destructor, the journal replays it on the next start.
+            scanResult.willRetry = true;
+        } else if (journal && scan->journalId) {
+            unsigned attempt = retryable ? ++attempts[scan->journalId] : 0;
+            auto age = std::chrono::system_clock::now() - scan->createdAt;
+            bool exhausted = (retryOptions.maxAttempts && attempt >= retryOptions.maxAttempts)
+                || (retryOptions.maxAge.count() && age >= retryOptions.maxAge);
+            if (retryable && !exhausted) {
+                auto delay = nextDelay();
+                delayed.emplace(std::chrono::steady_clock::now() + delay, scan->journalId);
+                scanResult.willRetry = true;
+                qDebug() << "upload" << scan->journalId << "will be retried in" << delay.count() << "ms";
+            } else {
+                if (retryable) {
+                    qDebug() << "upload" << scan->journalId << "failed" << attempt << "times, giving up";
+                } else if (!result.ok()) {
+                    qDebug() << "upload" << scan->journalId << "rejected with HTTP status" << result.httpStatus;
+                }
+                if (result.ok()) {
+                    journal->ack(scan->journalId);
+                } else {
+                    journal->deadLetter(scan->journalId);
+                }
+                attempts.erase(scan->journalId);
+            }
+        }
+
+        notify(*scan, scanResult);
+        --outstanding;
+    }
+
+    // The endpoint is back: forget the backoff and drain the backlog right away.
+    if (journal && result.ok() && (consecutiveFailures || !delayed.empty())) {
+        consecutiveFailures = 0;
+        for (auto &entry : delayed) {
+            replayQueue.push_back(entry.second);
+        }
+        delayed.clear();
+    }
+}
+
+void DocumentSender::releaseTransfer(Request &request) {
+    releaseHandle(request.easy);
+    request.easy = nullptr;
+    curl_mime_free(request.mime);
+    request.mime = nullptr;
+    curl_slist_free_all(request.headerList);
+    request.headerList = nullptr;
+    request.readers.clear();
+    request.compressed.clear();
+}
+
+void DocumentSender::notify(Request &request, const Result &result) {
+    if (request.notified) {
+        return;
+    }
+    request.notified = true;
+
+    if (request.group) {
+        LaneGroup &group = *request.group;
+        bool done = false;
+        {
+            std::lock_guard<std::mutex> lock(group.mutex);
+            bool willRetry = group.result.willRetry || result.willRetry;
+            // The first failure wins, otherwise the last successful half is reported.
+            if (group.result.ok()) {
+                group.result = result;
+            }
+            group.result.willRetry = willRetry;
+            done = --group.remaining == 0;
+        }
+
+        if (done) {
+            if (group.callback) {
+                group.callback(group.result);
+            }
+            group.promise.set_value(group.result);
+        }
+        return;
+    }
+
+    if (request.callback) {
+        request.callback(result);
+    }
+    request.promise.set_value(result);
+}
+
+size_t DocumentSender::readPart(char *buffer, size_t size, size_t nitems, void *arg) {
+    auto reader = static_cast<PartReader *>(arg);
+    size_t length = std::min(size * nitems, reader->size - reader->offset);
+    std::memcpy(buffer, reader->data + reader->offset, length);
+    reader->offset += length;
+    return length;
+}
+
+int DocumentSender::seekPart(void *arg, curl_off_t offset, int origin) {
+    auto reader = static_cast<PartReader *>(arg);
+    if (origin != SEEK_SET || offset < 0 || static_cast<size_t>(offset) > reader->size) {
+        return CURL_SEEKFUNC_CANTSEEK;
+    }
+    reader->offset = static_cast<size_t>(offset);
+    return CURL_SEEKFUNC_OK;
+}
+
+size_t DocumentSender::readHeader(char *buffer, size_t size, size_t nitems, void *arg) {
+    auto request = static_cast<Request *>(arg);
+    size_t length = size * nitems;
+    if (!request) {
+        return length;
+    }
+
+    std::string line(buffer, length);
+    for (auto &c : line) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+
+    // A status line starts the headers of the next response, e.g. after a redirect.
+    if (line.compare(0, 5, "http/") == 0) {
+        request->acceptEncoding = -1;
+        return length;
+    }
+
+    static const std::string name = "accept-encoding:";
+    if (line.compare(0, name.size(), name) != 0) {
+        return length;
+    }
+
+    int mask = 0;
+    std::istringstream codings(line.substr(name.size()));
+    std::string coding;
+    while (std::getline(codings, coding, ',')) {
+        // "gzip;q=0" refuses the coding, any other weight accepts it.
+        size_t params = coding.find(';');
+        std::string weight = params == std::string::npos ? "" : coding.substr(params + 1);
+        weight.erase(std::remove_if(weight.begin(), weight.end(), ::isspace), weight.end());
+        coding = coding.substr(0, params);
+        coding.erase(std::remove_if(coding.begin(), coding.end(), ::isspace), coding.end());
+        if (weight.compare(0, 2, "q=") == 0 && weight.find_first_not_of("0.", 2) == std::string::npos) {
+            continue;
+        }
+
+        for (auto codec : { DocumentCompressor::Gzip, DocumentCompressor::Zstd }) {
+            if (coding == DocumentCompressor::encodingName(codec)) {
+                mask |= 1 << codec;
+            }
+        }
+    }
+    request->acceptEncoding = mask;
+    return length;
+}
+
+void DocumentSender::setHeaders(std::vector<std::string> &h) {
+    headers = h;
 }
 
 void DocumentSender::addMimePart(std::string name, std::string value, bool isFile) {
-    preparedMime.push_back(Mime{ name, value, isFile });
+    preparedMime.push_back(Mime{ std::move(name), std::move(value), isFile });
+}
+
+void DocumentSender::addMimeBuffer(std::string name, std::vector<uint8_t> &&buffer, std::string filename, std::string type) {
+    Mime m{ name, "", false };
+    m.buffer = std::make_shared<const std::vector<uint8_t>>(std::move(buffer));
+    m.data = m.buffer->data();
+    m.size = m.buffer->size();
+    m.filename = filename;
+    m.type = type;
+    preparedMime.push_back(std::move(m));
+}
+
+void DocumentSender::addMimeBuffer(std::string name, const uint8_t *data, size_t size, std::string filename, std::string type) {
+    Mime m{ name, "", false };
+    m.data = data;
+    m.size = size;
+    m.filename = filename;
+    m.type = type;
+    preparedMime.push_back(std::move(m));
 }
 
 bool DocumentSender::mimeIsExist(std::string name)
 {
     bool isExist = false;
-    for (auto mime : preparedMime)
+    for (auto &mime : preparedMime)
     {
         if (mime.name == name)
         {
@@ -65,19 +874,212 @@ unsigned DocumentSender::howManyMimeParts() {
     return preparedMime.size();
 }
 
-void DocumentSender::doPost(std::string url) {
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "POST");
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+std::future<DocumentSender::Result> DocumentSender::enqueue(std::string url, Callback callback) {
+    std::unique_ptr<Request> request(new Request);
+    request->url = url;
+    request->parts.swap(preparedMime);
+    request->headers = headers;
+    request->callback = callback;
+    request->enqueuedAt = std::chrono::steady_clock::now();
+    request->createdAt = std::chrono::system_clock::now();
+
+    auto future = request->promise.get_future();
+
+    std::vector<std::unique_ptr<Request>> requests;
+    if (lanesEnabled) {
+        requests = splitByLane(request);
+    }
+    if (requests.empty()) {
+        requests.push_back(std::move(request));
+    }
 
-        setUpMime();
+    outstanding += static_cast<unsigned>(requests.size());
 
-        CURLcode res = curl_easy_perform(curl);
-        if (res != CURLE_OK) {
-            qDebug() << "curl_easy_perform() failed:" << curl_easy_strerror(res) << "\n";
+    if (!multi) {
+        Result failed;
+        failed.code = CURLE_FAILED_INIT;
+        failed.error = "curl multi handle is not available";
+        // complete() belongs to the I/O thread, there is nothing to release or retry here.
+        for (auto &r : requests) {
+            notify(*r, failed);
+            --outstanding;
         }
+        return future;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (auto &r : requests) {
+            pending.push_back(std::move(r));
+        }
+    }
+    curl_multi_wakeup(multi);
+
+    return future;
+}
+
+void DocumentSender::journalRequest(DocumentOutbox &journal, Request &request) {
+    DocumentOutbox::Upload upload;
+    upload.createdAt = request.createdAt;
+    upload.lane = static_cast<uint32_t>(request.lane);
+    upload.url = request.url;
+    upload.headers = request.headers;
+    for (auto &m : request.parts) {
+        DocumentOutbox::Part part;
+        part.name = m.name;
+        part.isFile = m.isFile;
+        part.filename = m.filename;
+        part.type = m.type;
+        part.data = m.data ? m.data : reinterpret_cast<const uint8_t *>(m.value.data());
+        part.size = m.data ? m.size : m.value.size();
+        upload.parts.push_back(part);
+    }
+    request.journalId = journal.append(upload);
+}
+
+unsigned DocumentSender::inFlightCount() {
+    return outstanding;
+}
+
+bool DocumentSender::attachOutbox(std::string path) {
+    return attachOutbox(path, RetryOptions());
+}
+
+bool DocumentSender::attachOutbox(std::string path, RetryOptions options) {
+    auto journal = std::make_shared<DocumentOutbox>(path);
+    if (!journal->open()) {
+        return false;
+    }
+
+    auto ids = journal->pendingIds();
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        retryOptions = options;
+        outbox = journal;
+        recovered.insert(recovered.end(), ids.begin(), ids.end());
+    }
+    if (multi) {
+        curl_multi_wakeup(multi);
+    }
+    return true;
+}
+
+size_t DocumentSender::outboxBacklog() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return outbox ? outbox->pendingCount() : 0;
+}
 
-        preparedMime.clear();
+bool DocumentSender::setCompression(DocumentCompressor::Codec codec, int level, size_t minSize) {
+    if (!DocumentCompressor::isAvailable(codec)) {
+        qDebug() << "Compression codec" << DocumentCompressor::encodingName(codec) << "is not available";
+        return false;
     }
+
+    compressionThreshold = minSize;
+    compressionLevel = level;
+    compressionCodec = codec;
+    return true;
+}
+
+const LatencyHistogram &DocumentSender::phaseHistogram(Phase phase) const {
+    return phaseHistograms[phase];
+}
+
+const LatencyHistogram &DocumentSender::sentBytesHistogram() const {
+    return sentBytes;
+}
+
+unsigned long DocumentSender::statusCount(int statusClass) {
+    if (statusClass < 0 || statusClass > 5) {
+        return 0;
+    }
+    return statusClasses[statusClass];
+}
+
+std::string DocumentSender::metricsReport() {
+    static const char *phaseNames[PhaseCount] = {
+        "dns", "connect", "tls", "pretransfer", "upload", "firstByte", "total"
+    };
+
+    std::ostringstream os;
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        os << phaseNames[phase] << " (us): " << phaseHistograms[phase].summary() << "\n";
+    }
+    os << "sent (bytes): " << sentBytes.summary() << "\n";
+    os << "status: none=" << statusClasses[0];
+    for (int statusClass = 1; statusClass <= 5; ++statusClass) {
+        os << " " << statusClass << "xx=" << statusClasses[statusClass];
+    }
+    os << "\n";
+
+    auto connections = connectionStats();
+    os << "connections: reused=" << connections.reused << " opened=" << connections.opened << "\n";
+
+    if (dedupEnabled) {
+        auto dedup = dedupStats();
+        os << "dedup: lookups=" << dedup.lookups << " hits=" << dedup.hits
+           << " hitRate=" << dedup.hitRate() << " rejected=" << dedup.rejected
+           << " bytesSaved=" << dedup.bytesSaved << "\n";
+    }
+    return os.str();
+}
+
+void DocumentSender::dumpMetrics() {
+    std::istringstream report(metricsReport());
+    std::string line;
+    while (std::getline(report, line)) {
+        qDebug() << line.c_str();
+    }
+}
+
+void DocumentSender::setLanes(bool enabled, curl_off_t maxSendSpeed, unsigned concurrency) {
+    bulkSendSpeed = maxSendSpeed;
+    bulkConcurrency = concurrency;
+    lanesEnabled = enabled;
+}
+
+void DocumentSender::setBatching(unsigned maxScans, std::chrono::milliseconds window) {
+    batchWindow = window.count();
+    batchLimit = maxScans;
+    if (multi) {
+        curl_multi_wakeup(multi);
+    }
+}
+
+DocumentSender::BatchStats DocumentSender::batchStats() {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return batchCounters;
+}
+
+DocumentCompressor::Stats DocumentSender::compressionStats() {
+    return compressor.stats();
+}
+
+void DocumentSender::setDeduplication(bool enabled, size_t capacity, size_t minSize) {
+    {
+        std::lock_guard<std::mutex> lock(dedupMutex);
+        digests.resize(capacity);
+    }
+    dedupMinSize = minSize;
+    dedupEnabled = enabled;
+}
+
+DocumentSender::DedupStats DocumentSender::dedupStats() {
+    DedupStats stats;
+    stats.lookups = dedupLookups;
+    stats.hits = dedupHits;
+    stats.rejected = dedupRejected;
+    stats.bytesSaved = dedupSaved;
+    return stats;
+}
+
+DocumentSender::ConnectionStats DocumentSender::connectionStats() {
+    ConnectionStats stats;
+    stats.reused = reusedConnections;
+    stats.opened = openedConnections;
+    return stats;
+}
+
+void DocumentSender::doPost(std::string url) {
+    enqueue(url).wait();
 }
@@ -1,37 +1,322 @@
 #ifndef DOCUMENTSENDER_H
 #define DOCUMENTSENDER_H
 
+#include "documentoutbox.h"
+#include "documentcompressor.h"
+#include "latencyhistogram.h"
+#include "digestcache.h"
 #include <QDebug>
 #include <curl/curl.h>
 #include <iostream>
 #include <vector>
 #include <string>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <chrono>
+#include <random>
+#include <array>
 
 class DocumentSender {
-private:
-    CURL *curl = nullptr;
+public:
+    enum Phase {
+        PhaseDns,           // name resolution
+        PhaseConnect,       // TCP connect
+        PhaseTls,           // TLS handshake, zero for plain HTTP
+        PhasePretransfer,   // from connected until the request starts
+        PhaseUpload,        // sending the request body
+        PhaseFirstByte,     // from the last byte sent until the first response byte
+        PhaseTotal,
+        PhaseCount
+    };
+
+    struct Timings {
+        std::array<std::chrono::microseconds, PhaseCount> phases{};
+        curl_off_t bytesSent = 0;
+    };
+
+    struct Result {
+        CURLcode code = CURLE_OK;
+        long httpStatus = 0;
+        std::string error;
+        // The upload is kept in the outbox and will be sent again later.
+        bool willRetry = false;
+        Timings timings;
+
+        bool ok() const { return code == CURLE_OK && httpStatus < 400; }
+    };
+
+    using Callback = std::function<void(const Result &)>;
+
+    struct PoolOptions {
+        long maxHostConnections = 4;
+        long idleTimeout = 60; // seconds a cached connection may stay unused
+        unsigned maxIdleHandles = 8;
+    };
+
+    struct RetryOptions {
+        std::chrono::milliseconds baseDelay = std::chrono::milliseconds(500);
+        std::chrono::milliseconds maxDelay = std::chrono::seconds(60);
+        // An upload still failing after this many attempts, or this long after it was
+        // queued, is moved to the dead-letter journal. 0 disables the limit.
+        unsigned maxAttempts = 20;
+        std::chrono::seconds maxAge = std::chrono::hours(24);
+    };
+
+    struct BatchStats {
+        unsigned long batches = 0;
+        unsigned long scans = 0;
+        // Time scans spent waiting for their batch to be flushed.
+        std::chrono::microseconds totalWait{ 0 };
+        std::chrono::microseconds maxWait{ 0 };
+
+        std::chrono::microseconds meanWait() const { return scans ? totalWait / static_cast<long>(scans) : std::chrono::microseconds(0); }
+    };
 
-    struct curl_slist *headers = nullptr;
+    struct ConnectionStats {
+        unsigned long reused = 0;
+        unsigned long opened = 0;
+    };
+
+    struct DedupStats {
+        unsigned long lookups = 0;
+        unsigned long hits = 0;
+        // References the server did not resolve, their scans were sent again in full.
+        unsigned long rejected = 0;
+        unsigned long long bytesSaved = 0;
+
+        double hitRate() const { return lookups ? double(hits) / double(lookups) : 0.0; }
+    };
+
+private:
     struct Mime {
         std::string name;
         std::string value;
         bool isFile;
+
+        // In-memory payload; `data` points either into `buffer` or into caller-owned memory.
+        std::shared_ptr<const std::vector<uint8_t>> buffer;
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+        std::string filename;
+        std::string type;
+    };
+
+    // Read position of one streamed part, curl pulls the bytes straight from the source.
+    struct PartReader {
+        const char *data;
+        size_t size;
+        size_t offset;
+    };
+
+    enum class Lane {
+        Normal,
+        High,
+        Bulk
+    };
+
+    // Completion shared by the metadata and bulk halves of a scan split across lanes.
+    struct LaneGroup {
+        std::mutex mutex;
+        std::promise<Result> promise;
+        Callback callback;
+        Result result;
+        unsigned remaining = 0;
+    };
+
+    static size_t readPart(char *, size_t, size_t, void *);
+    static int seekPart(void *, curl_off_t, int);
+    static size_t readHeader(char *, size_t, size_t, void *);
+
+    // One queued upload. Owned by the I/O thread once it leaves `pending`.
+    struct Request {
+        std::string url;
+        std::vector<Mime> parts;
+        std::vector<std::string> headers;
+
+        CURL *easy = nullptr;
+        curl_mime *mime = nullptr;
+        struct curl_slist *headerList = nullptr;
+        std::deque<PartReader> readers;
+        std::deque<std::vector<uint8_t>> compressed;
+        // Codecs of the response's Accept-Encoding header as a mask of 1 << Codec, -1 without one.
+        int acceptEncoding = -1;
+
+        std::promise<Result> promise;
+        Callback callback;
+        bool notified = false;
+
+        uint64_t journalId = 0;
+        std::chrono::steady_clock::time_point enqueuedAt;
+        std::chrono::system_clock::time_point createdAt;
+
+        Lane lane = Lane::Normal;
+        std::shared_ptr<LaneGroup> group;
+
+        // Scans coalesced into this request when it is a batch.
+        std::vector<std::unique_ptr<Request>> members;
+
+        // Digests of parts sent in full and of parts sent as references.
+        std::vector<std::string> digests;
+        std::vector<std::string> references;
+        size_t referencedBytes = 0;
+        bool fullContent = false;
     };
 
-    curl_mime *mime = nullptr;
-    curl_mimepart *part = nullptr;
+    std::vector<std::string> headers;
+
+    PoolOptions poolOptions;
+    std::atomic<bool> running;
+    std::atomic<unsigned> outstanding;
+
+    CURLM *multi = nullptr;
+    CURLSH *share = nullptr;
+    std::mutex shareLocks[CURL_LOCK_DATA_LAST];
+    std::vector<CURL *> idleHandles;
+
+    std::atomic<unsigned long> reusedConnections;
+    std::atomic<unsigned long> openedConnections;
+
+    static void lockShare(CURL *, curl_lock_data, curl_lock_access, void *);
+    static void unlockShare(CURL *, curl_lock_data, void *);
+
+    CURL *acquireHandle();
+    void releaseHandle(CURL *);
+
+    std::thread ioThread;
+
+    std::mutex queueMutex;
+    std::deque<std::unique_ptr<Request>> pending;
+    std::deque<uint64_t> recovered;
+    std::shared_ptr<DocumentOutbox> outbox;
+    std::map<CURL *, std::unique_ptr<Request>> inFlight;
+
+    // Outbox replay state, touched by the I/O thread only.
+    RetryOptions retryOptions;
+    unsigned consecutiveFailures = 0;
+    std::deque<uint64_t> replayQueue;
+    std::multimap<std::chrono::steady_clock::time_point, uint64_t> delayed;
+    std::map<uint64_t, unsigned> attempts;
+    std::mt19937 jitter;
+
+    DocumentCompressor compressor;
+    std::atomic<int> compressionCodec;
+    std::atomic<int> compressionLevel;
+    std::atomic<size_t> compressionThreshold;
+    // Codecs the server accepts in requests (RFC 7694), learned from its responses.
+    std::atomic<unsigned> acceptedEncodings;
 
-    void setUpMime();
+    std::atomic<unsigned> batchLimit;
+    std::atomic<long> batchWindow;
+    std::vector<std::unique_ptr<Request>> openBatch;
+    std::chrono::steady_clock::time_point batchDeadline;
+
+    std::atomic<bool> lanesEnabled;
+    std::atomic<long long> bulkSendSpeed;
+    std::atomic<unsigned> bulkConcurrency;
+    std::deque<std::unique_ptr<Request>> bulkQueue;
+
+    std::atomic<bool> dedupEnabled;
+    std::atomic<size_t> dedupMinSize;
+    std::mutex dedupMutex;
+    DigestCache digests;
+    std::atomic<unsigned long> dedupLookups;
+    std::atomic<unsigned long> dedupHits;
+    std::atomic<unsigned long> dedupRejected;
+    std::atomic<unsigned long long> dedupSaved;
+
+    bool deduplicate(Request &, curl_mimepart *, const Mime &);
+
+    std::array<LatencyHistogram, PhaseCount> phaseHistograms;
+    LatencyHistogram sentBytes;
+    // Responses by status class: [0] no response, [1] 1xx ... [5] 5xx.
+    std::array<std::atomic<unsigned long>, 6> statusClasses;
+
+    void recordTimings(CURL *, Result &);
+
+    std::mutex statsMutex;
+    BatchStats batchCounters;
+
+    void ioLoop();
+    void replay(DocumentOutbox &);
+    std::chrono::milliseconds nextDelay();
+    int pollTimeout(bool);
+    void addToBatch(std::unique_ptr<Request>);
+    void flushBatch();
+    std::vector<std::unique_ptr<Request>> splitByLane(std::unique_ptr<Request> &);
+    void dispatch(std::unique_ptr<Request>);
+    void startBulk();
+    void journalRequest(DocumentOutbox &, Request &);
+    void startRequest(std::unique_ptr<Request>);
+    void finishRequest(CURL *, CURLcode);
+    void complete(std::unique_ptr<Request>, Result);
+    void releaseTransfer(Request &);
+    void notify(Request &, const Result &);
 public:
     std::vector<Mime> preparedMime;
 
+    // curl_global_init() must have been called, see main().
     DocumentSender();
+    explicit DocumentSender(PoolOptions);
     ~DocumentSender();
 
     void setHeaders(std::vector<std::string> &);
     void addMimePart(std::string, std::string, bool = false);
+    // Owned buffer: moved into the sender, no copy is made.
+    void addMimeBuffer(std::string, std::vector<uint8_t> &&, std::string = "", std::string = "");
+    // Borrowed buffer: must stay alive until the upload's future is ready.
+    void addMimeBuffer(std::string, const uint8_t *, size_t, std::string = "", std::string = "");
     bool mimeIsExist(std::string);
     unsigned howManyMimeParts();
+
+    // Hands the prepared parts to the I/O thread and returns immediately.
+    // The callback (if any) runs on the I/O thread.
+    std::future<Result> enqueue(std::string, Callback = nullptr);
+    unsigned inFlightCount();
+
+    // Journals every following upload and replays the ones left from a previous run.
+    // Uploads the server rejects or that run out of retries end up in "<path>.dead".
+    bool attachOutbox(std::string);
+    bool attachOutbox(std::string, RetryOptions);
+    size_t outboxBacklog();
+
+    // Text parts of at least `minSize` bytes are sent with a Content-Encoding part header,
+    // once a response of the server has listed the codec in an Accept-Encoding header. A
+    // 415 answer to a compressed upload clears what was learned and sends it uncompressed.
+    bool setCompression(DocumentCompressor::Codec, int = 6, size_t = 1024);
+    DocumentCompressor::Stats compressionStats();
+
+    // Coalesces up to `maxScans` uploads to the same URL, or whatever arrives within
+    // `window`, into one request with parts named "<name>[<index>]". 0 or 1 disables it.
+    void setBatching(unsigned, std::chrono::milliseconds);
+    BatchStats batchStats();
+
+    // Splits every scan in two requests sharing a "scanId" part: text parts go first on
+    // a high-priority lane, file buffers follow on a bulk lane capped at `maxSendSpeed`
+    // bytes/s (0 is unlimited) with at most `concurrency` transfers at a time.
+    void setLanes(bool, curl_off_t = 0, unsigned = 1);
+
+    // File buffers of at least `minSize` bytes whose digest is among the last `capacity`
+    // ones the server accepted are sent as an empty part with an X-Content-Ref header
+    // instead of the bytes. Other file buffers carry an X-Content-Digest header so the
+    // server can keep them. A 409 answer makes the sender forget the references of that
+    // upload and send it again in full.
+    void setDeduplication(bool, size_t = 256, size_t = 4096);
+    DedupStats dedupStats();
+
+    // Per-request phase timings (microseconds) and request body sizes (bytes).
+    const LatencyHistogram &phaseHistogram(Phase) const;
+    const LatencyHistogram &sentBytesHistogram() const;
+    unsigned long statusCount(int);
+    std::string metricsReport();
+    void dumpMetrics();
+    ConnectionStats connectionStats();
+
     void doPost(std::string);
 };
 
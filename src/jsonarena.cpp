@@ -0,0 +1,43 @@
+#include "jsonarena.h"
+
+namespace Json {
+
+Arena::Arena(size_t size) :
+    blockSize(size)
+{
+}
+
+void *Arena::allocate(size_t size, size_t alignment) {
+    // Blocks left over from before a reset are reused in order before a new one is made.
+    for (; current < blocks.size(); ++current, offset = 0) {
+        size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+        if (aligned + size <= blocks[current].size) {
+            offset = aligned + size;
+            bytes += size;
+            return blocks[current].data.get() + aligned;
+        }
+    }
+
+    size_t capacity = size > blockSize ? size : blockSize;
+    blocks.push_back(Block{ std::unique_ptr<char[]>(new char[capacity]), capacity });
+    current = blocks.size() - 1;
+    offset = size;
+    bytes += size;
+    return blocks[current].data.get();
+}
+
+void Arena::reset() {
+    current = 0;
+    offset = 0;
+    bytes = 0;
+}
+
+size_t Arena::reserved() const {
+    size_t total = 0;
+    for (auto &block : blocks) {
+        total += block.size;
+    }
+    return total;
+}
+
+}
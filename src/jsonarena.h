@@ -0,0 +1,43 @@
+#ifndef JSONARENA_H
+#define JSONARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace Json {
+
+// Bump allocator for transient parse state: unescaped strings and structural indexes.
+// reset() hands the same blocks out again, so once an arena has seen a scan of a given
+// shape, further scans of that shape allocate nothing. Not thread-safe.
+class Arena {
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    size_t blockSize;
+    std::vector<Block> blocks;
+    size_t current = 0;
+    size_t offset = 0;
+    size_t bytes = 0;
+
+public:
+    explicit Arena(size_t = 64 * 1024);
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    // Memory stays valid until the next reset().
+    void *allocate(size_t, size_t = alignof(std::max_align_t));
+    template<typename T>
+    T *allocate(size_t count) { return static_cast<T *>(allocate(count * sizeof(T), alignof(T))); }
+
+    void reset();
+    // Bytes handed out since the last reset, and bytes held in blocks.
+    size_t used() const { return bytes; }
+    size_t reserved() const;
+};
+
+}
+
+#endif
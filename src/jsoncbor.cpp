@@ -0,0 +1,655 @@
+#include "jsoncbor.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace Json {
+
+const char *const Cbor::mimeType = "application/cbor";
+const char *const Cbor::fileExtension = ".cbor";
+
+namespace {
+
+const unsigned maxDepth = 512;
+
+enum Major {
+    Unsigned = 0,
+    Negative = 1,
+    Bytes = 2,
+    Text = 3,
+    ArrayOf = 4,
+    MapOf = 5,
+    Tag = 6,
+    Simple = 7
+};
+
+const uint64_t tagStringRef = 25;
+const uint64_t tagBase64 = 22;
+const uint64_t tagStringRefNamespace = 256;
+
+// Strings shorter than this are never entered into the stringref table, a reference to
+// them would not be smaller than the string itself.
+inline size_t minReferenced(size_t tableSize) {
+    if (tableSize < 24) {
+        return 3;
+    }
+    if (tableSize < 256) {
+        return 4;
+    }
+    if (tableSize < 65536) {
+        return 5;
+    }
+    return tableSize < 4294967296ULL ? 7 : 11;
+}
+
+// Longer strings are only counted in the table, not looked up.
+const size_t maxInterned = 64;
+// Only strings this long are tried as base64.
+const size_t minBase64 = 128;
+
+const char base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+struct Base64Values {
+    signed char value[256];
+
+    Base64Values() {
+        std::memset(value, -1, sizeof(value));
+        for (int i = 0; i < 64; ++i) {
+            value[static_cast<unsigned char>(base64Alphabet[i])] = static_cast<signed char>(i);
+        }
+    }
+};
+
+inline signed char base64Value(unsigned char c) {
+    static const Base64Values values;
+    return values.value[c];
+}
+
+// Decoded size when `s` is padded base64 that re-encodes to exactly the same text, 0 otherwise.
+size_t canonicalBase64(std::string_view s) {
+    if (s.size() < 4 || s.size() % 4) {
+        return 0;
+    }
+    size_t padding = s[s.size() - 1] == '=' ? (s[s.size() - 2] == '=' ? 2 : 1) : 0;
+    size_t digits = s.size() - padding;
+    for (size_t i = 0; i < digits; ++i) {
+        if (base64Value(static_cast<unsigned char>(s[i])) < 0) {
+            return 0;
+        }
+    }
+    // Bits below the last full byte must be zero, otherwise they would be lost.
+    int lastValue = base64Value(static_cast<unsigned char>(s[digits - 1]));
+    if ((padding == 1 && (lastValue & 0x03)) || (padding == 2 && (lastValue & 0x0F))) {
+        return 0;
+    }
+    return s.size() / 4 * 3 - padding;
+}
+
+void decodeBase64(std::string_view s, uint8_t *out) {
+    size_t i = 0;
+    for (; i + 4 <= s.size(); i += 4) {
+        uint32_t group = 0;
+        unsigned bytes = 3;
+        for (size_t j = 0; j < 4; ++j) {
+            if (s[i + j] == '=') {
+                --bytes;
+                group <<= 6;
+            } else {
+                group = (group << 6) | static_cast<uint32_t>(base64Value(static_cast<unsigned char>(s[i + j])));
+            }
+        }
+        *out++ = static_cast<uint8_t>(group >> 16);
+        if (bytes > 1) {
+            *out++ = static_cast<uint8_t>(group >> 8);
+        }
+        if (bytes > 2) {
+            *out++ = static_cast<uint8_t>(group);
+        }
+    }
+}
+
+void appendBase64(std::string &out, const uint8_t *data, size_t size) {
+    size_t at = out.size();
+    out.resize(at + (size + 2) / 3 * 4);
+    char *o = &out[at];
+    size_t i = 0;
+    for (; i + 3 <= size; i += 3) {
+        uint32_t group = (uint32_t(data[i]) << 16) | (uint32_t(data[i + 1]) << 8) | data[i + 2];
+        *o++ = base64Alphabet[group >> 18];
+        *o++ = base64Alphabet[(group >> 12) & 0x3F];
+        *o++ = base64Alphabet[(group >> 6) & 0x3F];
+        *o++ = base64Alphabet[group & 0x3F];
+    }
+    if (i < size) {
+        uint32_t group = uint32_t(data[i]) << 16;
+        if (i + 1 < size) {
+            group |= uint32_t(data[i + 1]) << 8;
+        }
+        *o++ = base64Alphabet[group >> 18];
+        *o++ = base64Alphabet[(group >> 12) & 0x3F];
+        *o++ = i + 1 < size ? base64Alphabet[(group >> 6) & 0x3F] : '=';
+        *o++ = '=';
+    }
+}
+
+void appendEscaped(std::string &out, const char *s, size_t size) {
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    const char *run = s;
+    const char *end = s + size;
+    for (; s < end; ++s) {
+        unsigned char c = static_cast<unsigned char>(*s);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.append(run, static_cast<size_t>(s - run));
+        run = s + 1;
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        default:
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 0x0F];
+            break;
+        }
+    }
+    out.append(run, static_cast<size_t>(end - run));
+    out += '"';
+}
+
+void appendDouble(std::string &out, double value) {
+    if (!std::isfinite(value)) {
+        out += "null";
+        return;
+    }
+    // Shortest precision that reads back as the same double.
+    char digits[32];
+    for (int precision = 15; precision <= 17; ++precision) {
+        int length = Scanner::formatDouble(digits, sizeof(digits), precision, value);
+        if (Scanner::toDouble(digits, static_cast<size_t>(length)) == value) {
+            break;
+        }
+    }
+    out += digits;
+    // Keeps integral values floating point for readers that care about the type.
+    if (!std::strpbrk(digits, ".eE")) {
+        out += ".0";
+    }
+}
+
+// Member names and short values only, eight bytes at a time.
+uint64_t hashString(std::string_view s) {
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ s.size();
+    size_t i = 0;
+    for (; i + 8 <= s.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, s.data() + i, sizeof(word));
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+    if (i < s.size()) {
+        uint64_t word = 0;
+        std::memcpy(&word, s.data() + i, s.size() - i);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+uint64_t readBigEndian(const uint8_t *p, unsigned bytes) {
+    uint64_t value = 0;
+    for (unsigned i = 0; i < bytes; ++i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+double halfToDouble(uint16_t half) {
+    int exponent = (half >> 10) & 0x1F;
+    int mantissa = half & 0x3FF;
+    double value;
+    if (exponent == 0) {
+        value = std::ldexp(mantissa, -24);
+    } else if (exponent != 31) {
+        value = std::ldexp(mantissa + 1024, exponent - 25);
+    } else {
+        value = mantissa == 0 ? INFINITY : NAN;
+    }
+    return half & 0x8000 ? -value : value;
+}
+
+}
+
+void Cbor::head(unsigned major, uint64_t value) {
+    std::vector<uint8_t> &o = *out;
+    uint8_t initial = static_cast<uint8_t>(major << 5);
+    if (value < 24) {
+        o.push_back(static_cast<uint8_t>(initial | value));
+        return;
+    }
+    unsigned bytes = value <= 0xFF ? 1 : value <= 0xFFFF ? 2 : value <= 0xFFFFFFFFULL ? 4 : 8;
+    o.push_back(static_cast<uint8_t>(initial | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27)));
+    for (unsigned i = bytes; i-- > 0;) {
+        o.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+// Containers are written with a one byte head and widened once their size is known.
+void Cbor::patchHead(size_t at, unsigned major, uint64_t count) {
+    std::vector<uint8_t> &o = *out;
+    uint8_t initial = static_cast<uint8_t>(major << 5);
+    if (count < 24) {
+        o[at] = static_cast<uint8_t>(initial | count);
+        return;
+    }
+    unsigned bytes = count <= 0xFF ? 1 : count <= 0xFFFF ? 2 : count <= 0xFFFFFFFFULL ? 4 : 8;
+    o.insert(o.begin() + static_cast<std::ptrdiff_t>(at + 1), bytes, 0);
+    o[at] = static_cast<uint8_t>(initial | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27));
+    for (unsigned i = 0; i < bytes; ++i) {
+        o[at + 1 + i] = static_cast<uint8_t>(count >> (8 * (bytes - 1 - i)));
+    }
+}
+
+bool Cbor::encode(const char *data, size_t size, std::vector<uint8_t> &result) {
+    out = &result;
+    result.clear();
+    result.reserve(size / 2);
+    interned.assign(interned.empty() ? 1024 : interned.size(), Interned{ 0, nullptr, 0, 0 });
+    internedCount = 0;
+    tableSize = 0;
+    strings.reset();
+
+    in.reset(data, size);
+    head(Tag, tagStringRefNamespace);
+    bool ok = encodeValue(0);
+    if (ok && in.peek()) {
+        ok = in.fail("trailing characters");
+    }
+    out = nullptr;
+    return ok;
+}
+
+bool Cbor::encodeValue(unsigned depth) {
+    char c = in.peek();
+    if (!c) {
+        return in.fail("unexpected end of input");
+    }
+    if (depth > maxDepth) {
+        return in.fail("nesting is too deep");
+    }
+
+    Span span;
+    if (c == '{' || c == '[') {
+        size_t at = out->size();
+        out->push_back(0);
+        uint64_t count = 0;
+        bool first = true;
+        in.enter(c);
+        if (c == '{') {
+            while (in.nextMember(first, span)) {
+                encodeString(span);
+                if (!encodeValue(depth + 1)) {
+                    return false;
+                }
+                ++count;
+            }
+        } else {
+            while (in.nextElement(first)) {
+                if (!encodeValue(depth + 1)) {
+                    return false;
+                }
+                ++count;
+            }
+        }
+        patchHead(at, c == '{' ? MapOf : ArrayOf, count);
+        return !in.failed();
+    }
+
+    if (c == '"') {
+        if (!in.string(span)) {
+            return false;
+        }
+        encodeString(span);
+        return true;
+    }
+
+    if (!in.scalar(span)) {
+        return false;
+    }
+    if (span.type == Null) {
+        out->push_back(0xF6);
+    } else if (span.type == Bool) {
+        out->push_back(span.begin[0] == 't' ? 0xF5 : 0xF4);
+    } else {
+        encodeNumber(span);
+    }
+    return true;
+}
+
+void Cbor::encodeString(const Span &span) {
+    std::string_view text(span.begin, span.size);
+    if (span.escaped) {
+        Scanner::unescape(span, unescaped);
+        text = unescaped;
+    }
+
+    uint64_t hash = 0;
+    if (text.size() <= maxInterned) {
+        hash = hashString(text);
+        if (const Interned *found = findInterned(text, hash)) {
+            head(Tag, tagStringRef);
+            head(Unsigned, found->index);
+            return;
+        }
+    }
+
+    size_t decoded = text.size() >= minBase64 ? canonicalBase64(text) : 0;
+    if (decoded) {
+        head(Tag, tagBase64);
+        head(Bytes, decoded);
+        size_t at = out->size();
+        out->resize(at + decoded);
+        decodeBase64(text, out->data() + at);
+        if (decoded >= minReferenced(tableSize)) {
+            ++tableSize;
+        }
+        return;
+    }
+
+    head(Text, text.size());
+    out->insert(out->end(), text.begin(), text.end());
+    if (text.size() >= minReferenced(tableSize)) {
+        if (text.size() <= maxInterned) {
+            if (span.escaped) {
+                // The key has to outlive `unescaped`.
+                char *copy = strings.allocate<char>(text.size());
+                std::memcpy(copy, text.data(), text.size());
+                text = std::string_view(copy, text.size());
+            }
+            intern(text, hash);
+        }
+        ++tableSize;
+    }
+}
+
+const Cbor::Interned *Cbor::findInterned(std::string_view text, uint64_t hash) const {
+    size_t mask = interned.size() - 1;
+    for (size_t i = hash & mask; interned[i].data; i = (i + 1) & mask) {
+        const Interned &slot = interned[i];
+        if (slot.hash == hash && slot.size == text.size() && std::memcmp(slot.data, text.data(), text.size()) == 0) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+void Cbor::intern(std::string_view text, uint64_t hash) {
+    // Kept at most half full.
+    if ((internedCount + 1) * 2 > interned.size()) {
+        std::vector<Interned> old(interned.size() * 2, Interned{ 0, nullptr, 0, 0 });
+        old.swap(interned);
+        size_t mask = interned.size() - 1;
+        for (auto &slot : old) {
+            if (slot.data) {
+                size_t i = slot.hash & mask;
+                while (interned[i].data) {
+                    i = (i + 1) & mask;
+                }
+                interned[i] = slot;
+            }
+        }
+    }
+
+    size_t mask = interned.size() - 1;
+    size_t i = hash & mask;
+    while (interned[i].data) {
+        i = (i + 1) & mask;
+    }
+    interned[i] = Interned{ hash, text.data(), static_cast<uint32_t>(text.size()), tableSize };
+    ++internedCount;
+}
+
+void Cbor::encodeNumber(const Span &span) {
+    const char *s = span.begin;
+    const char *end = span.begin + span.size;
+    bool negative = s < end && *s == '-';
+    bool integral = std::memchr(s, '.', span.size) == nullptr && std::memchr(s, 'e', span.size) == nullptr
+        && std::memchr(s, 'E', span.size) == nullptr;
+
+    if (integral) {
+        uint64_t magnitude = 0;
+        bool overflow = false;
+        for (const char *d = negative ? s + 1 : s; d < end; ++d) {
+            unsigned digit = static_cast<unsigned>(*d - '0');
+            overflow = overflow || digit > 9 || magnitude > (UINT64_MAX - digit) / 10;
+            magnitude = magnitude * 10 + digit;
+        }
+        if (!overflow) {
+            if (negative && magnitude) {
+                head(Negative, magnitude - 1);
+            } else {
+                head(Unsigned, magnitude);
+            }
+            return;
+        }
+    }
+
+    double value = Scanner::toDouble(span);
+
+    float narrow = static_cast<float>(value);
+    uint64_t bits;
+    unsigned bytes;
+    if (static_cast<double>(narrow) == value) {
+        uint32_t word;
+        std::memcpy(&word, &narrow, sizeof(word));
+        bits = word;
+        bytes = 4;
+        out->push_back(0xFA);
+    } else {
+        std::memcpy(&bits, &value, sizeof(bits));
+        bytes = 8;
+        out->push_back(0xFB);
+    }
+    for (unsigned i = bytes; i-- > 0;) {
+        out->push_back(static_cast<uint8_t>(bits >> (8 * i)));
+    }
+}
+
+bool Cbor::failDecode(const char *what) {
+    qDebug() << "CBOR decode failed at offset" << static_cast<long>(p - first) << ":" << what;
+    return false;
+}
+
+bool Cbor::decode(const uint8_t *data, size_t size, std::string &text) {
+    first = p = data;
+    last = data + size;
+    json = &text;
+    text.clear();
+    text.reserve(size * 2);
+    table.clear();
+
+    bool ok = decodeItem(0);
+    if (ok && p != last) {
+        ok = failDecode("trailing bytes");
+    }
+    json = nullptr;
+    return ok;
+}
+
+bool Cbor::readHead(unsigned &major, unsigned &additional, uint64_t &value) {
+    if (p >= last) {
+        return failDecode("unexpected end of input");
+    }
+    major = *p >> 5;
+    additional = *p & 0x1F;
+    ++p;
+
+    if (additional < 24) {
+        value = additional;
+        return true;
+    }
+    if (additional == 31) {
+        value = 0;
+        return true;
+    }
+    if (additional > 27) {
+        return failDecode("reserved additional information");
+    }
+    unsigned bytes = 1u << (additional - 24);
+    if (static_cast<size_t>(last - p) < bytes) {
+        return failDecode("truncated head");
+    }
+    value = readBigEndian(p, bytes);
+    p += bytes;
+    return true;
+}
+
+bool Cbor::decodeItem(unsigned depth) {
+    if (depth > maxDepth) {
+        return failDecode("nesting is too deep");
+    }
+
+    unsigned major, additional;
+    uint64_t value;
+    if (!readHead(major, additional, value)) {
+        return false;
+    }
+
+    std::string &o = *json;
+    switch (major) {
+    case Unsigned:
+        o += std::to_string(value);
+        return true;
+    case Negative:
+        // -1 - value, written without overflowing for value == UINT64_MAX.
+        o += '-';
+        o += value == UINT64_MAX ? "18446744073709551616" : std::to_string(value + 1);
+        return true;
+    case Bytes:
+    case Text:
+        return decodeString(major, additional, value, major == Bytes);
+    case ArrayOf:
+    case MapOf:
+        return decodeContainer(major, additional, value, depth);
+    case Tag:
+        if (value == tagStringRef) {
+            if (!readHead(major, additional, value) || major != Unsigned) {
+                return failDecode("string reference without an index");
+            }
+            if (value >= table.size()) {
+                return failDecode("string reference out of range");
+            }
+            const Entry &entry = table[value];
+            if (entry.bytes) {
+                o += '"';
+                appendBase64(o, entry.data, entry.size);
+                o += '"';
+            } else {
+                appendEscaped(o, reinterpret_cast<const char *>(entry.data), entry.size);
+            }
+            return true;
+        }
+        if (value == tagStringRefNamespace) {
+            std::vector<Entry> outer;
+            outer.swap(table);
+            bool ok = decodeItem(depth + 1);
+            table.swap(outer);
+            return ok;
+        }
+        // Base64 hints and unknown tags only annotate the item that follows.
+        return decodeItem(depth + 1);
+    default:
+        break;
+    }
+
+    switch (additional) {
+    case 20: o += "false"; return true;
+    case 21: o += "true"; return true;
+    case 22:
+    case 23: o += "null"; return true;
+    case 25: appendDouble(o, halfToDouble(static_cast<uint16_t>(value))); return true;
+    case 26: {
+        uint32_t word = static_cast<uint32_t>(value);
+        float narrow;
+        std::memcpy(&narrow, &word, sizeof(narrow));
+        appendDouble(o, narrow);
+        return true;
+    }
+    case 27: {
+        double wide;
+        std::memcpy(&wide, &value, sizeof(wide));
+        appendDouble(o, wide);
+        return true;
+    }
+    default:
+        return failDecode("unsupported simple value");
+    }
+}
+
+bool Cbor::decodeString(unsigned major, unsigned additional, uint64_t size, bool bytes) {
+    if (additional == 31) {
+        return failDecode("indefinite length strings are not supported");
+    }
+    if (size > static_cast<uint64_t>(last - p)) {
+        return failDecode("truncated string");
+    }
+
+    if (size >= minReferenced(table.size())) {
+        table.push_back(Entry{ p, static_cast<size_t>(size), major == Bytes });
+    }
+    if (bytes) {
+        *json += '"';
+        appendBase64(*json, p, static_cast<size_t>(size));
+        *json += '"';
+    } else {
+        appendEscaped(*json, reinterpret_cast<const char *>(p), static_cast<size_t>(size));
+    }
+    p += size;
+    return true;
+}
+
+bool Cbor::decodeContainer(unsigned major, unsigned additional, uint64_t count, unsigned depth) {
+    std::string &o = *json;
+    bool indefinite = additional == 31;
+    bool map = major == MapOf;
+    o += map ? '{' : '[';
+
+    for (uint64_t i = 0; indefinite || i < count; ++i) {
+        if (indefinite) {
+            if (p >= last) {
+                return failDecode("unterminated container");
+            }
+            if (*p == 0xFF) {
+                ++p;
+                break;
+            }
+        }
+        if (i) {
+            o += ',';
+        }
+        if (map) {
+            size_t key = o.size();
+            if (!decodeItem(depth + 1)) {
+                return false;
+            }
+            if (o[key] != '"') {
+                return failDecode("map key is not a string");
+            }
+            o += ':';
+        }
+        if (!decodeItem(depth + 1)) {
+            return false;
+        }
+    }
+
+    o += map ? '}' : ']';
+    return true;
+}
+
+}
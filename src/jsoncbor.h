@@ -0,0 +1,77 @@
+#ifndef JSONCBOR_H
+#define JSONCBOR_H
+
+#include "jsonarena.h"
+#include "jsonscanner.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Json {
+
+// Converts SDK results between JSON text and CBOR (RFC 8949).
+//
+// The document is wrapped in a stringref namespace (tags 256/25), so every member name
+// and short repeated value is written once and referenced by index afterwards. Long
+// base64 strings, the images of Authenticity results, travel as byte strings tagged 22
+// and are turned back into the same base64 text by decode(). Integers and booleans keep
+// their type; strings come back with JSON escapes normalized.
+class Cbor {
+    // Short strings in the stringref table of the document being encoded, an
+    // open-addressing set keyed by contents.
+    struct Interned {
+        uint64_t hash;
+        const char *data;
+        uint32_t size;
+        uint32_t index;
+    };
+    std::vector<Interned> interned;
+    size_t internedCount = 0;
+    uint32_t tableSize = 0;
+    Arena strings;
+    std::string unescaped;
+    Scanner in;
+    std::vector<uint8_t> *out = nullptr;
+
+    // Decoder state, the table views strings of the input.
+    struct Entry {
+        const uint8_t *data;
+        size_t size;
+        bool bytes;
+    };
+    std::vector<Entry> table;
+    const uint8_t *first = nullptr;
+    const uint8_t *p = nullptr;
+    const uint8_t *last = nullptr;
+    std::string *json = nullptr;
+
+    bool encodeValue(unsigned);
+    void encodeString(const Span &);
+    void encodeNumber(const Span &);
+    const Interned *findInterned(std::string_view, uint64_t) const;
+    void intern(std::string_view, uint64_t);
+    void head(unsigned, uint64_t);
+    void patchHead(size_t, unsigned, uint64_t);
+
+    bool decodeItem(unsigned);
+    bool readHead(unsigned &, unsigned &, uint64_t &);
+    bool decodeString(unsigned, unsigned, uint64_t, bool);
+    bool decodeContainer(unsigned, unsigned, uint64_t, unsigned);
+    bool failDecode(const char *);
+
+public:
+    static const char *const mimeType;
+    static const char *const fileExtension;
+
+    bool encode(const char *, size_t, std::vector<uint8_t> &);
+    bool encode(const std::string &text, std::vector<uint8_t> &data) { return encode(text.data(), text.size(), data); }
+
+    // Writes compact JSON text.
+    bool decode(const uint8_t *, size_t, std::string &);
+    bool decode(const std::vector<uint8_t> &data, std::string &text) { return decode(data.data(), data.size(), text); }
+};
+
+}
+
+#endif
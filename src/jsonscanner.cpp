@@ -0,0 +1,331 @@
+#include "jsonscanner.h"
+#include "jsonstructural.h"
+
+#include <locale.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace Json {
+
+namespace {
+
+char *appendUtf8(char *out, unsigned long codepoint) {
+    if (codepoint < 0x80) {
+        *out++ = static_cast<char>(codepoint);
+    } else if (codepoint < 0x800) {
+        *out++ = static_cast<char>(0xC0 | (codepoint >> 6));
+        *out++ = static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else if (codepoint < 0x10000) {
+        *out++ = static_cast<char>(0xE0 | (codepoint >> 12));
+        *out++ = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        *out++ = static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else {
+        *out++ = static_cast<char>(0xF0 | (codepoint >> 18));
+        *out++ = static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+        *out++ = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        *out++ = static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+    return out;
+}
+
+unsigned long parseHex4(const char *p) {
+    char digits[5] = { p[0], p[1], p[2], p[3], 0 };
+    return std::strtoul(digits, nullptr, 16);
+}
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+}
+
+void Scanner::reset(const char *data, size_t size, const StructuralIndex *index) {
+    first = p = data;
+    last = data + size;
+    error = false;
+    structural = structuralEnd = nullptr;
+    if (index && index->covers(data, size)) {
+        structural = index->begin();
+        structuralEnd = index->end();
+    }
+}
+
+// Moves the index past everything before `at`, true when `at` itself is structural.
+bool Scanner::seek(size_t at) {
+    while (structural < structuralEnd && *structural < at) {
+        ++structural;
+    }
+    return structural < structuralEnd && *structural == at;
+}
+
+bool Scanner::fail(const char *what) {
+    if (!error) {
+        qDebug() << "JSON scan failed at offset" << static_cast<long>(offset()) << ":" << what;
+    }
+    error = true;
+    return false;
+}
+
+bool Scanner::string(Span &span) {
+    if (peek() != '"') {
+        return fail("expected a string");
+    }
+
+    const char *start = ++p;
+    if (structural && seek(offset() - 1) && structural + 1 < structuralEnd) {
+        // The next entry after an opening quote is its closing quote.
+        const char *quote = first + structural[1];
+        structural += 2;
+        p = quote + 1;
+        span = Span{ String, start, static_cast<size_t>(quote - start),
+            std::memchr(start, '\\', static_cast<size_t>(quote - start)) != nullptr };
+        return true;
+    }
+
+    bool escaped = false;
+    while (true) {
+        const char *quote = static_cast<const char *>(std::memchr(p, '"', static_cast<size_t>(last - p)));
+        if (!quote) {
+            p = last;
+            return fail("unterminated string");
+        }
+
+        // The quote is escaped when an odd number of backslashes precedes it.
+        const char *back = quote;
+        while (back > start && back[-1] == '\\') {
+            --back;
+        }
+        escaped = escaped || back != quote || std::memchr(start, '\\', static_cast<size_t>(back - start));
+        p = quote + 1;
+        if ((quote - back) % 2 == 0) {
+            span = Span{ String, start, static_cast<size_t>(quote - start), escaped };
+            return true;
+        }
+    }
+}
+
+bool Scanner::scalar(Span &span) {
+    peek();
+    const char *start = p;
+    while (p < last && *p != ',' && *p != '}' && *p != ']' && *p != ':' && !isSpace(*p)) {
+        ++p;
+    }
+    if (p == start) {
+        return fail("expected a value");
+    }
+
+    ValueType type = Number;
+    if (*start == 't' || *start == 'f') {
+        type = Bool;
+    } else if (*start == 'n') {
+        type = Null;
+    } else if (*start != '-' && (*start < '0' || *start > '9')) {
+        return fail("invalid literal");
+    }
+    span = Span{ type, start, static_cast<size_t>(p - start), false };
+    return true;
+}
+
+bool Scanner::skip(Span &span) {
+    char c = peek();
+    if (c == '"') {
+        return string(span);
+    }
+    if (c != '{' && c != '[') {
+        return scalar(span);
+    }
+
+    const char *start = p;
+    if (!skipContainer()) {
+        return false;
+    }
+    span = Span{ c == '{' ? Object : Array, start, static_cast<size_t>(p - start), false };
+    return true;
+}
+
+bool Scanner::skipContainer() {
+    unsigned depth = 0;
+    if (structural && seek(offset())) {
+        // Strings never contribute brackets to the index, only their quotes.
+        for (; structural < structuralEnd; ++structural) {
+            char c = first[*structural];
+            if (c == '{' || c == '[') {
+                ++depth;
+            } else if ((c == '}' || c == ']') && --depth == 0) {
+                p = first + *structural++ + 1;
+                return true;
+            }
+        }
+        p = last;
+        return fail("unterminated container");
+    }
+
+    while (p < last) {
+        char c = *p++;
+        if (c == '"') {
+            while (p < last && *p != '"') {
+                p += *p == '\\' ? 2 : 1;
+            }
+            if (p >= last) {
+                break;
+            }
+            ++p;
+        } else if (c == '{' || c == '[') {
+            ++depth;
+        } else if (c == '}' || c == ']') {
+            if (--depth == 0) {
+                return true;
+            }
+        }
+    }
+    p = last;
+    return fail("unterminated container");
+}
+
+bool Scanner::enter(char open) {
+    if (peek() != open) {
+        return fail(open == '{' ? "expected an object" : "expected an array");
+    }
+    ++p;
+    return true;
+}
+
+bool Scanner::nextMember(bool &firstMember, Span &key) {
+    char c = peek();
+    if (c == '}') {
+        ++p;
+        return false;
+    }
+    if (!firstMember) {
+        if (c != ',') {
+            return fail("expected ',' or '}'");
+        }
+        ++p;
+    }
+    firstMember = false;
+
+    if (!string(key)) {
+        return false;
+    }
+    if (peek() != ':') {
+        return fail("expected ':'");
+    }
+    ++p;
+    return true;
+}
+
+bool Scanner::nextElement(bool &firstElement) {
+    char c = peek();
+    if (c == ']') {
+        ++p;
+        return false;
+    }
+    if (!firstElement) {
+        if (c != ',') {
+            return fail("expected ',' or ']'");
+        }
+        ++p;
+    }
+    firstElement = false;
+    return !error;
+}
+
+bool Scanner::equals(const Span &span, const std::string &expected) {
+    if (span.escaped) {
+        std::string text;
+        unescape(span, text);
+        return text == expected;
+    }
+    return span.size == expected.size() && std::memcmp(span.begin, expected.data(), span.size) == 0;
+}
+
+long Scanner::toLong(const Span &span) {
+    char digits[32];
+    size_t size = span.size < sizeof(digits) - 1 ? span.size : sizeof(digits) - 1;
+    std::memcpy(digits, span.begin, size);
+    digits[size] = 0;
+    return std::strtol(digits, nullptr, 10);
+}
+
+namespace {
+
+locale_t cLocale() {
+    static const locale_t locale = newlocale(LC_ALL_MASK, "C", nullptr);
+    return locale;
+}
+
+}
+
+double Scanner::toDouble(const char *text, size_t size) {
+    char digits[64];
+    std::string longer;
+    const char *terminated = digits;
+    if (size < sizeof(digits)) {
+        std::memcpy(digits, text, size);
+        digits[size] = 0;
+    } else {
+        longer.assign(text, size);
+        terminated = longer.c_str();
+    }
+    return strtod_l(terminated, nullptr, cLocale());
+}
+
+int Scanner::formatDouble(char *out, size_t size, int precision, double value) {
+    // No snprintf_l() in glibc, switch the calling thread's locale instead.
+    locale_t previous = uselocale(cLocale());
+    int length = std::snprintf(out, size, "%.*g", precision, value);
+    uselocale(previous);
+    return length;
+}
+
+void Scanner::unescape(const Span &span, std::string &out) {
+    out.resize(span.size);
+    out.resize(unescape(span, &out[0]));
+}
+
+size_t Scanner::unescape(const Span &span, char *out) {
+    char *o = out;
+    const char *s = span.begin;
+    const char *end = span.begin + span.size;
+    while (s < end) {
+        if (*s != '\\' || s + 1 >= end) {
+            *o++ = *s++;
+            continue;
+        }
+
+        char c = s[1];
+        s += 2;
+        switch (c) {
+        case 'b': *o++ = '\b'; break;
+        case 'f': *o++ = '\f'; break;
+        case 'n': *o++ = '\n'; break;
+        case 'r': *o++ = '\r'; break;
+        case 't': *o++ = '\t'; break;
+        case 'u': {
+            if (end - s < 4) {
+                s = end;
+                break;
+            }
+            unsigned long codepoint = parseHex4(s);
+            s += 4;
+            if (codepoint >= 0xD800 && codepoint < 0xDC00 && end - s >= 6 && s[0] == '\\' && s[1] == 'u') {
+                unsigned long low = parseHex4(s + 2);
+                if (low >= 0xDC00 && low < 0xE000) {
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                    s += 6;
+                }
+            }
+            o = appendUtf8(o, codepoint);
+            break;
+        }
+        default:
+            *o++ = c;
+            break;
+        }
+    }
+    return static_cast<size_t>(o - out);
+}
+
+}
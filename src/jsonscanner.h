@@ -0,0 +1,85 @@
+#ifndef JSONSCANNER_H
+#define JSONSCANNER_H
+
+#include <QDebug>
+#include <cstdint>
+#include <string>
+
+namespace Json {
+
+class StructuralIndex;
+
+enum ValueType {
+    Missing,
+    Null,
+    Bool,
+    Number,
+    String,
+    Object,
+    Array
+};
+
+// A value inside the scanned text. Strings exclude their quotes and are still escaped.
+struct Span {
+    ValueType type = Missing;
+    const char *begin = nullptr;
+    size_t size = 0;
+    bool escaped = false;
+};
+
+// Forward-only tokenizer over a borrowed JSON text, shared by the streaming readers.
+// Nothing is allocated; malformed input makes every call return false and sets failed().
+class Scanner {
+    const char *first = nullptr;
+    const char *last = nullptr;
+    const char *p = nullptr;
+    bool error = false;
+    // Unread part of a structural index of the text, when one was given.
+    const uint32_t *structural = nullptr;
+    const uint32_t *structuralEnd = nullptr;
+
+    bool seek(size_t);
+    bool skipContainer();
+public:
+    // With an index built over the same text, strings and skipped containers are
+    // resolved from the index instead of byte by byte.
+    void reset(const char *, size_t, const StructuralIndex * = nullptr);
+
+    bool failed() const { return error; }
+    bool fail(const char *);
+    size_t offset() const { return static_cast<size_t>(p - first); }
+    const char *position() const { return p; }
+    // Next significant character without consuming it, 0 at the end of input.
+    char peek() {
+        while (p < last && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+            ++p;
+        }
+        return p < last && !error ? *p : 0;
+    }
+
+    bool string(Span &);
+    bool scalar(Span &);
+    // Steps over any value, containers included.
+    bool skip(Span &);
+
+    // Consume the opening bracket, then call nextMember()/nextElement() until they return
+    // false at the closing bracket. `first` must start out true for every container.
+    bool enter(char);
+    bool nextMember(bool &, Span &);
+    bool nextElement(bool &);
+
+    static bool equals(const Span &, const std::string &);
+    static void unescape(const Span &, std::string &);
+    // Writes at most span.size bytes, unescaping never makes a string longer.
+    static size_t unescape(const Span &, char *);
+    static long toLong(const Span &);
+    // JSON numbers always use '.', whatever LC_NUMERIC the application set.
+    static double toDouble(const char *, size_t);
+    static double toDouble(const Span &span) { return toDouble(span.begin, span.size); }
+    // snprintf("%.*g") in the "C" locale.
+    static int formatDouble(char *, size_t, int, double);
+};
+
+}
+
+#endif
@@ -0,0 +1,228 @@
+#include "jsonstructural.h"
+#include "jsonarena.h"
+
+#include <QDebug>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define JSON_STRUCTURAL_X86
+#endif
+
+namespace Json {
+
+namespace {
+
+// Character classes of one 64-byte block, bit i stands for byte i.
+struct Masks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t operators;
+};
+
+using Classify = void (*)(const char *, Masks &);
+
+void classifyScalar(const char *block, Masks &m) {
+    m = Masks{ 0, 0, 0 };
+    for (unsigned i = 0; i < 64; ++i) {
+        uint64_t bit = 1ULL << i;
+        switch (block[i]) {
+        case '"': m.quote |= bit; break;
+        case '\\': m.backslash |= bit; break;
+        case '{': case '}': case '[': case ']': case ':': case ',': m.operators |= bit; break;
+        default: break;
+        }
+    }
+}
+
+#ifdef JSON_STRUCTURAL_X86
+__attribute__((target("sse4.2")))
+void classifySse42(const char *block, Masks &m) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    // Setting 0x20 folds '[' onto '{' and ']' onto '}', no other byte maps onto them.
+    const __m128i fold = _mm_set1_epi8(0x20);
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+
+    m = Masks{ 0, 0, 0 };
+    for (unsigned i = 0; i < 4; ++i) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 16 * i));
+        __m128i folded = _mm_or_si128(chunk, fold);
+        __m128i ops = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, colon), _mm_cmpeq_epi8(chunk, comma)),
+            _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)));
+
+        m.quote |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote)))) << (16 * i);
+        m.backslash |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslash)))) << (16 * i);
+        m.operators |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(ops))) << (16 * i);
+    }
+}
+
+__attribute__((target("avx2")))
+void classifyAvx2(const char *block, Masks &m) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i fold = _mm256_set1_epi8(0x20);
+    const __m256i open = _mm256_set1_epi8('{');
+    const __m256i close = _mm256_set1_epi8('}');
+
+    m = Masks{ 0, 0, 0 };
+    for (unsigned i = 0; i < 2; ++i) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 32 * i));
+        __m256i folded = _mm256_or_si256(chunk, fold);
+        __m256i ops = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, colon), _mm256_cmpeq_epi8(chunk, comma)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(folded, open), _mm256_cmpeq_epi8(folded, close)));
+
+        m.quote |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, quote)))) << (32 * i);
+        m.backslash |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, backslash)))) << (32 * i);
+        m.operators |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(ops))) << (32 * i);
+    }
+}
+#endif
+
+// Characters preceded by an odd run of backslashes. `carry` is 1 when the previous
+// block ended inside such a run and becomes the same flag for the next block.
+inline uint64_t escapedBy(uint64_t backslash, uint64_t &carry) {
+    const uint64_t even = 0x5555555555555555ULL;
+    const uint64_t odd = ~even;
+
+    uint64_t starts = backslash & ~(backslash << 1);
+    uint64_t evenStartMask = even ^ carry;
+    uint64_t evenStarts = starts & evenStartMask;
+    uint64_t oddStarts = starts & ~evenStartMask;
+
+    uint64_t evenCarries = backslash + evenStarts;
+    uint64_t oddCarries;
+    bool overflow = __builtin_add_overflow(backslash, oddStarts, &oddCarries);
+    oddCarries |= carry;
+    carry = overflow ? 1 : 0;
+
+    uint64_t evenCarryEnds = evenCarries & ~backslash;
+    uint64_t oddCarryEnds = oddCarries & ~backslash;
+    return (evenCarryEnds & odd) | (oddCarryEnds & even);
+}
+
+// Bit i is set when byte i lies between an opening quote and its closing quote.
+inline uint64_t prefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+}
+
+StructuralIndex::Implementation StructuralIndex::best() {
+    static const Implementation detected = isSupported(Avx2) ? Avx2 : isSupported(Sse42) ? Sse42 : Scalar;
+    return detected;
+}
+
+bool StructuralIndex::isSupported(Implementation implementation) {
+#ifdef JSON_STRUCTURAL_X86
+    switch (implementation) {
+    case Avx2: return __builtin_cpu_supports("avx2");
+    case Sse42: return __builtin_cpu_supports("sse4.2");
+    default: return true;
+    }
+#else
+    return implementation == Scalar;
+#endif
+}
+
+const char *StructuralIndex::name(Implementation implementation) {
+    switch (implementation) {
+    case Avx2: return "avx2";
+    case Sse42: return "sse4.2";
+    default: return "scalar";
+    }
+}
+
+void StructuralIndex::grow(size_t size) {
+    if (!arena) {
+        offsets.resize(size);
+        capacity = size;
+        return;
+    }
+    uint32_t *fresh = arena->allocate<uint32_t>(size);
+    if (used) {
+        std::memcpy(fresh, borrowed, used * sizeof(uint32_t));
+    }
+    borrowed = fresh;
+    capacity = size;
+}
+
+bool StructuralIndex::build(const char *data, size_t size, Implementation implementation) {
+    text = data;
+    length = size;
+    used = 0;
+    if (size >= UINT32_MAX) {
+        qDebug() << "JSON text is too large to index:" << size;
+        text = nullptr;
+        return false;
+    }
+
+    Classify classify = classifyScalar;
+#ifdef JSON_STRUCTURAL_X86
+    if (!isSupported(implementation)) {
+        implementation = best();
+    }
+    if (implementation == Avx2) {
+        classify = classifyAvx2;
+    } else if (implementation == Sse42) {
+        classify = classifySse42;
+    }
+#endif
+
+    // Typical results have a structural character every 6-10 bytes.
+    if (arena || capacity < size / 4 + 64) {
+        grow(size / 4 + 64);
+    }
+
+    uint64_t backslashCarry = 0;
+    uint64_t inStringCarry = 0;
+    char tail[64];
+    Masks m;
+
+    for (size_t base = 0; base < size; base += 64) {
+        const char *block = data + base;
+        if (size - base < 64) {
+            std::memset(tail, ' ', sizeof(tail));
+            std::memcpy(tail, block, size - base);
+            block = tail;
+        }
+        classify(block, m);
+
+        uint64_t quotes = m.quote & ~escapedBy(m.backslash, backslashCarry);
+        uint64_t inString = prefixXor(quotes) ^ inStringCarry;
+        inStringCarry = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+
+        uint64_t structural = (m.operators & ~inString) | quotes;
+        if (capacity - used < 64) {
+            grow(capacity * 2);
+        }
+        uint32_t *out = storage() + used;
+        while (structural) {
+            *out++ = static_cast<uint32_t>(base + __builtin_ctzll(structural));
+            structural &= structural - 1;
+        }
+        used = static_cast<size_t>(out - storage());
+    }
+
+    if (inStringCarry) {
+        qDebug() << "JSON text ends inside a string";
+        text = nullptr;
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,63 @@
+#ifndef JSONSTRUCTURAL_H
+#define JSONSTRUCTURAL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Json {
+
+class Arena;
+
+// Offsets of every structural character of a JSON text: braces, brackets, colons and
+// commas outside of strings, plus the opening and closing quote of every string.
+// The text is classified 64 bytes at a time with AVX2 or SSE4.2 when the CPU has them,
+// escapes and string interiors are resolved with bit arithmetic on the block masks.
+// Scanner uses the index to jump over strings and whole containers.
+class StructuralIndex {
+public:
+    enum Implementation {
+        Scalar,
+        Sse42,
+        Avx2
+    };
+
+private:
+    const char *text = nullptr;
+    size_t length = 0;
+    std::vector<uint32_t> offsets;
+    size_t used = 0;
+
+    // With an arena the offsets live there instead of in `offsets`.
+    Arena *arena = nullptr;
+    uint32_t *borrowed = nullptr;
+    size_t capacity = 0;
+
+    uint32_t *storage() { return arena ? borrowed : offsets.data(); }
+    void grow(size_t);
+
+public:
+    StructuralIndex() = default;
+    // Every build() takes fresh space from the arena, it must not be reset while the
+    // index is in use.
+    explicit StructuralIndex(Arena *arena) : arena(arena) {}
+
+    // Fastest implementation the running CPU supports.
+    static Implementation best();
+    static bool isSupported(Implementation);
+    static const char *name(Implementation);
+
+    // Returns false for an unterminated string or a text of 4 GiB or more, the index
+    // then covers nothing.
+    bool build(const char *, size_t, Implementation = best());
+    bool build(const std::string &data, Implementation implementation = best()) { return build(data.data(), data.size(), implementation); }
+
+    bool covers(const char *data, size_t size) const { return text == data && length == size; }
+    const uint32_t *begin() const { return arena ? borrowed : offsets.data(); }
+    const uint32_t *end() const { return begin() + used; }
+    size_t size() const { return used; }
+};
+
+}
+
+#endif
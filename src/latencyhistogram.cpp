@@ -0,0 +1,107 @@
+#include "latencyhistogram.h"
+
+#include <sstream>
+
+LatencyHistogram::LatencyHistogram() :
+    samples(0),
+    sum(0),
+    maximum(0)
+{
+    for (auto &bucket : buckets) {
+        bucket = 0;
+    }
+}
+
+unsigned LatencyHistogram::bucketOf(uint64_t value) {
+    if (value < linearLimit) {
+        return static_cast<unsigned>(value);
+    }
+
+    unsigned exponent = 63 - __builtin_clzll(value);
+    if (exponent >= maxExponent) {
+        return bucketCount - 1;
+    }
+
+    unsigned sub = static_cast<unsigned>((value >> (exponent - 3)) & (subBuckets - 1));
+    return linearLimit + (exponent - 4) * subBuckets + sub;
+}
+
+uint64_t LatencyHistogram::upperBound(unsigned bucket) {
+    if (bucket < linearLimit) {
+        return bucket;
+    }
+
+    unsigned exponent = (bucket - linearLimit) / subBuckets + 4;
+    uint64_t sub = (bucket - linearLimit) % subBuckets;
+    uint64_t width = 1ULL << (exponent - 3);
+    return (1ULL << exponent) + (sub + 1) * width - 1;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    samples.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t seen = maximum.load(std::memory_order_relaxed);
+    while (value > seen && !maximum.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (auto &bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    samples.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const {
+    return samples.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::mean() const {
+    uint64_t n = count();
+    return n ? sum.load(std::memory_order_relaxed) / n : 0;
+}
+
+uint64_t LatencyHistogram::max() const {
+    return maximum.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::percentile(double quantile) const {
+    uint64_t total = 0;
+    for (auto &bucket : buckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (!total) {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(quantile * total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < bucketCount; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t bound = upperBound(i);
+            uint64_t top = max();
+            return bound < top ? bound : top;
+        }
+    }
+    return max();
+}
+
+std::string LatencyHistogram::summary() const {
+    std::ostringstream os;
+    os << "n=" << count()
+       << " mean=" << mean()
+       << " p50=" << percentile(0.50)
+       << " p95=" << percentile(0.95)
+       << " p99=" << percentile(0.99)
+       << " max=" << max();
+    return os.str();
+}
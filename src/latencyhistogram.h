@@ -0,0 +1,41 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Log-linear histogram of microsecond samples: exact below 16 us, then 8 buckets per
+// power of two (about 12% relative error). Recording is wait-free and can happen from
+// any thread; readers see a consistent-enough snapshot for reporting.
+class LatencyHistogram {
+private:
+    static const unsigned subBuckets = 8;
+    static const unsigned linearLimit = 16;
+    static const unsigned maxExponent = 40; // ~12.7 days in microseconds
+    static const unsigned bucketCount = linearLimit + (maxExponent - 4) * subBuckets;
+
+    std::array<std::atomic<uint64_t>, bucketCount> buckets;
+    std::atomic<uint64_t> samples;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> maximum;
+
+    static unsigned bucketOf(uint64_t);
+    static uint64_t upperBound(unsigned);
+public:
+    LatencyHistogram();
+
+    void record(uint64_t);
+    void reset();
+
+    uint64_t count() const;
+    uint64_t mean() const;
+    uint64_t max() const;
+    // Upper bound of the bucket holding the given quantile (0.0 - 1.0).
+    uint64_t percentile(double) const;
+
+    std::string summary() const;
+};
+
+#endif
@@ -1,12 +1,22 @@
 #include "mainwindow.h"
 #include <QApplication>
 #include <QFontDatabase>
+#include <curl/curl.h>
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+    // Not thread-safe on older libcurl, so once here before any DocumentSender exists.
+    curl_global_init(CURL_GLOBAL_DEFAULT);
 
-    MainWindow w;
-    w.show();
-    return a.exec();
+    int result;
+    {
+        QApplication a(argc, argv);
+
+        MainWindow w;
+        w.show();
+        result = a.exec();
+    }
+
+    curl_global_cleanup();
+    return result;
 }
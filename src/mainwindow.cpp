@@ -22,6 +22,24 @@
 
 MainWindow* MainWindow::currentWindow = nullptr;
 
+static std::string imageExtension(const ResultView &image)
+{
+    const uint8_t *buffer = image.data();
+    if (image.size() >= 2 && buffer[0] == 'B' && buffer[1] == 'M')
+        return ".bmp";
+    if (image.size() >= 4 && buffer[0] == 0x89 && buffer[1] == 'P' && buffer[2] == 'N' && buffer[3] == 'G')
+        return ".png";
+    return ".jpg";
+}
+
+static void writeArtifact(const std::string &path, const void *data, size_t size)
+{
+    std::fstream fstream;
+    fstream.open(path, std::ios_base::out | std::ios_base::binary);
+    fstream.write((const char *)data, size);
+    fstream.close();
+}
+
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow)
@@ -35,19 +53,54 @@ MainWindow::MainWindow(QWidget *parent) :
     if (ui_settings.contains("checkbox/autoscan")) {
         ui->AutoscanCheckBox->setChecked(ui_settings.value("checkbox/autoscan").toBool());
     }
+    saveArtifacts = ui_settings.value("artifacts/save", false).toBool();
+    cborArtifacts = ui_settings.value("artifacts/format", "text").toString() == "cbor";
+    cborUpload = ui_settings.value("upload/dataFormat", "text").toString() == "cbor";
+    pipelineRfid = ui_settings.value("process/pipelineRfid", false).toBool();
+    Reader.SetDeviceIndex(ui_settings.value("device/index", -1).toInt());
+    Reader.SetRfidEnabled(ui_settings.value("rfid/enabled", false).toBool());
+    Reader.SetStageDeadline(std::chrono::milliseconds(ui_settings.value("process/stageDeadlineMs", 0).toInt()));
+    Reader.SetRfidProfiles(ui_settings.value("rfid/profiles", "rfid_profiles.ini").toString());
+    Reader.SetRfidProfile(ui_settings.value("rfid/profile", "default").toString().toStdString());
 
     connect(this, SIGNAL(documentInserted()), SLOT(on_DocumentInserted()));
-    connect(this, SIGNAL(askCalibrationOject(int)), SLOT(on_AskCalibrationObject(int)));
+    // The SDK thread waits for the prompt to be answered, as the calibration step it reports
+    // needs the object in place.
+    connect(this, SIGNAL(askCalibrationOject(int)), SLOT(on_AskCalibrationObject(int)), Qt::BlockingQueuedConnection);
     connect(this, SIGNAL(deviceDisconnected()), SLOT(on_DeviceDisconnected()));
     connect(this, SIGNAL(containerIsReady(TResultContainer*)), SLOT(showVdResults(TResultContainer*)));
+    connect(this, SIGNAL(processFinished(long, bool)), SLOT(on_ProcessFinished(long, bool)));
+    connect(this, SIGNAL(rfidFinished(long)), SLOT(on_RfidFinished(long)));
+    connect(this, SIGNAL(calibrationFinished(long)), SLOT(on_CalibrationFinished(long)));
     new QShortcut(QKeySequence(Qt::CTRL + Qt::Key_Q), this, SLOT(close()));
+    new QShortcut(QKeySequence(Qt::CTRL + Qt::Key_M), this, SLOT(dumpUploadMetrics()));
 
     std::vector<std::string> headers;
     headers.push_back("Content-Type: multipart/form-data");
-    headers.push_back("Connection: close");
 
     sender = new DocumentSender();
     sender->setHeaders(headers);
+    sender->attachOutbox(ui_settings.value("outbox/path", "outbox.journal").toString().toStdString());
+
+    QString compression = ui_settings.value("upload/compression", "none").toString();
+    int compressionLevel = ui_settings.value("upload/compressionLevel", 6).toInt();
+    if (compression == "gzip") {
+        sender->setCompression(DocumentCompressor::Gzip, compressionLevel);
+    } else if (compression == "zstd") {
+        sender->setCompression(DocumentCompressor::Zstd, compressionLevel);
+    }
+    sender->setBatching(
+        ui_settings.value("upload/batchSize", 0).toUInt(),
+        std::chrono::milliseconds(ui_settings.value("upload/batchWindowMs", 500).toInt())
+    );
+    sender->setLanes(
+        ui_settings.value("upload/priorityLanes", false).toBool(),
+        ui_settings.value("upload/bulkMaxBytesPerSec", 0).toLongLong()
+    );
+    sender->setDeduplication(
+        ui_settings.value("upload/dedup", false).toBool(),
+        ui_settings.value("upload/dedupCacheSize", 256).toUInt()
+    );
 }
 
 MainWindow::~MainWindow()
@@ -56,6 +109,7 @@ MainWindow::~MainWindow()
     ui_settings.setValue("checkbox/videoDetection", ui->VdCheckBox->isChecked());
     // ui_settings.setValue("checkbox/jsonFormat", ui->JsonCheckBox->isChecked());
     ui_settings.setValue("checkbox/autoscan", ui->AutoscanCheckBox->isChecked());
+    ui_settings.setValue("artifacts/save", saveArtifacts);
 
     delete ui;
     delete sender;
@@ -88,56 +142,43 @@ void MainWindow::on_DisconnectButton_clicked()
 {
     isDocumentProcessed = false;
     Reader.Disconnect();
+    pendingTabs.clear();
     ui->tabWidget->clear(); // clear results
     setStates(Reader.IsConnected());
 }
 
 void MainWindow::InsertTextTabsForContainer(const TResultContainer *container, const std::string &labelBase)
 {
-    std::string xmlString { (char*) container->XML_buffer, container->XML_length };
+    std::string_view xmlString { (char*) container->XML_buffer, container->XML_length };
 
     if(xmlString.empty())
         return;
 
-    std::filebuf fb;
-    fb.open ("tmp/" + labelBase + Reader.getFileExtension(), std::ios::out);
-    std::ostream os(&fb);
-    os << xmlString;
-    fb.close();
-    QPlainTextEdit *textEdit = new QPlainTextEdit(QString::fromStdString(xmlString), ui->tabWidget);
+    if (saveArtifacts) {
+        SaveResultArtifact(labelBase, xmlString);
+    }
+    QPlainTextEdit *textEdit = new QPlainTextEdit(QString::fromUtf8(xmlString.data(), xmlString.size()), ui->tabWidget);
     std::string tabName = labelBase;
     ui->tabWidget->insertTab(0, textEdit, tabName.c_str());
 }
 
-void MainWindow::InsertTextTabsForType(eRPRM_ResultType type, const std::string& labelBase)
+void MainWindow::SaveResultArtifact(const std::string& name, std::string_view result)
 {
-    long pageIndex = 0;
-    auto count = Reader.GetReaderResultsCount(type);
-
-    for(int i = 0; i < count; i++)
-    {
-        std::string xmlString = Reader.GetReaderResult(type, i, pageIndex);
-
-        if(xmlString.empty())
-            continue;
-
-        if (Reader.enableJson) {
-            if (labelBase == "Lex" && !lexJson.length()) {
-                lexJson.assign(xmlString);
-            } else if (labelBase == "DocType" && !docTypeJson.length() && lexJson.length()) {
-                docTypeJson.assign(xmlString);
-            }
-        }
-
-        std::filebuf fb;
-        fb.open ("tmp/" + labelBase + "_" + std::to_string(i) + Reader.getFileExtension(), std::ios::out);
-        std::ostream os(&fb);
-        os << xmlString;
-        fb.close();
-        QPlainTextEdit *textEdit = new QPlainTextEdit(QString::fromStdString(xmlString), ui->tabWidget);
-        std::string tabName = labelBase + "_" + std::to_string(i);
-        ui->tabWidget->insertTab(0, textEdit, tabName.c_str());
+    // XML results, and JSON that does not parse, are kept as text.
+    std::vector<uint8_t> packed;
+    if (cborArtifacts && Reader.enableJson && cbor.encode(result.data(), result.size(), packed)) {
+        std::fstream fstream;
+        fstream.open("tmp/" + name + Json::Cbor::fileExtension, std::ios_base::out | std::ios_base::binary);
+        fstream.write((const char *)packed.data(), packed.size());
+        fstream.close();
+        return;
     }
+
+    std::filebuf fb;
+    fb.open ("tmp/" + name + Reader.getFileExtension(), std::ios::out);
+    std::ostream os(&fb);
+    os << result;
+    fb.close();
 }
 
 void MainWindow::showVdResults(TResultContainer* container)
@@ -152,177 +193,154 @@ void MainWindow::showVdResults(TResultContainer* container)
 
 void MainWindow::on_ProcessButton_clicked()
 {
-    ClearTabs();
+    if(Reader.IsConnected() && !isProcessing && !isCalibrating)
+    {
+        ClearTabs();
+        if(hasResults)
+        {
+            // What the previous scan fetched, and what nobody looked at.
+            Reader.Results().report(std::cout);
+            hasResults = false;
+        }
+        isProcessing = true;
+        ui->ProcessButton->setEnabled(false);
+        procStart = std::chrono::high_resolution_clock::now();
+
+        intptr_t authCheckMode = (intptr_t)-1;
+        Reader.SetAuthenticityChecks(authCheckMode);
+        intptr_t processMode =
+            RPRM_GetImage_Modes_GetImages
+            | RPRM_GetImage_Modes_LocateDocument
+            | RPRM_GetImage_Modes_OCR_MRZ
+            | RPRM_GetImage_Modes_OCR_Visual
+            | RPRM_GetImage_Modes_OCR_BarCodes
+            | RPRM_GetImage_Modes_Authenticity
+            | RPRM_GetImage_Modes_DocumentType
+        ;
+
+        // With pipelined RFID the chip is read while on_ProcessFinished() extracts and uploads
+        // the optical results, on_RfidFinished() adds the chip data.
+        DocumentReader::RfidCallback rfidCallback;
+        if (pipelineRfid && Reader.IsRFIDConnected()) {
+            rfidCallback = [this](const DocumentReader::RfidResult &result) {
+                std::cout << "RFID read (ms): " << result.duration.count() / 1000.0
+                          << (result.timedOut ? " (deadline exceeded)" : "") << std::endl;
+                PrintRfidTimings(result.dataGroups);
+                Q_EMIT rfidFinished(result.code);
+            };
+        }
+
+        // The SDK works on its own thread, the results are read back in on_ProcessFinished().
+        Reader.ProcessAsync(processMode, [this](const DocumentReader::ProcessResult &result) {
+            auto ms = [&result](DocumentReader::Stage stage) { return result.timings[stage].count() / 1000.0; };
+            std::cout << "Processing stages (ms): process " << ms(DocumentReader::StageProcess)
+                      << ", lexical analysis " << ms(DocumentReader::StageLexicalAnalysis)
+                      << ", RFID " << ms(DocumentReader::StageRfid)
+                      << (result.cancelled ? " (cancelled)" : result.timedOut ? " (deadline exceeded)" : "") << std::endl;
+            Q_EMIT processFinished(result.code, result.rfidPending);
+        }, rfidCallback);
+    }
+}
+
+void MainWindow::on_ProcessFinished(long code, bool rfidPending)
+{
+    // A pending chip read keeps the scan busy until on_RfidFinished().
+    isProcessing = rfidPending;
+    ui->ProcessButton->setEnabled(Reader.IsConnected() && !isProcessing);
     if(Reader.IsConnected())
     {
-        auto proc_start = std::chrono::high_resolution_clock::now();
         try
         {
-            intptr_t authCheckMode = (intptr_t)-1;
-            Reader.SetAuthenticityChecks(authCheckMode);
-            intptr_t processMode =
-                RPRM_GetImage_Modes_GetImages
-                | RPRM_GetImage_Modes_LocateDocument
-                | RPRM_GetImage_Modes_OCR_MRZ
-                | RPRM_GetImage_Modes_OCR_Visual
-                | RPRM_GetImage_Modes_OCR_BarCodes
-                | RPRM_GetImage_Modes_Authenticity
-                | RPRM_GetImage_Modes_DocumentType
-            ;
-
-            if(Reader.Process(processMode) == RPRM_Error_NoError)
+            if(code == RPRM_Error_NoError)
             {
-                InsertTextTabsForType(RPRM_ResultType_OCRLexicalAnalyze, "Lex");
-                InsertTextTabsForType(RPRM_ResultType_Authenticity, "Auth");
-                InsertTextTabsForType(RPRM_ResultType_ChosenDocumentTypeCandidate, "DocType");
+                Reader.GetScanResult(scanResult);
+                scanFields = scanResult.scanFields();
+                hasResults = true;
+                // Tabs fetch their result when first shown, see LoadResultTab().
+                ResultSet &results = Reader.Results();
+                for(size_t id : results.select(ResultSet::Text))
+                {
+                    if(results.entry(id).resultType != RPRM_ResultType_Graphics)
+                        InsertResultTab(id, 0);
+                }
 
-                long resultsCount = Reader.GetReaderResultsCount(RPRM_ResultType_RawImage);
-                if (resultsCount == 1)
+                std::vector<size_t> images = results.select(ResultSet::Image);
+                if (images.size() == 1)
                 {
                     sender->preparedMime.clear();
                 }
 
                 long docType = 0;
-                std::string docSerial = "";
-                for(long i = 0; i < resultsCount; ++i) // and images
+                for(size_t id : images) // and images
                 {
-                    std::string lightType;
-                    long pageIndex;
-                    std::vector<uint8_t> imageVector = Reader.GetReaderResultImage(RPRM_ResultType_RawImage, i, lightType, pageIndex);
-                    QImage qimg;
-                    Json::Reader::MemberValue tmp;
-                    qimg.loadFromData(imageVector.data(), imageVector.size());
-                    QGraphicsScene* scene = new QGraphicsScene();
-                    scene->addPixmap(QPixmap::fromImage(qimg));
-                    QGraphicsView *view = new QGraphicsView(scene);
-                    view->setScene(scene);
-                    view->fitInView(scene->sceneRect(), Qt::KeepAspectRatio);
-                    view->update();
-                    ui->tabWidget->insertTab(ui->tabWidget->count(), view, QString(lightType.c_str()));
-
-                    if (lexJson.length() && !sender->mimeIsExist("data")) {
-                        Json::Reader *lexReader = new Json::Reader(lexJson);
-
-                        lexReader->fetch("ListVerifiedFields", "pFieldMaps");
-                        tmp = lexReader->searchElement("wFieldType", "Field_Visual", 165);
-                        docSerial = tmp.mvString;
-
-                        sender->addMimePart("data", lexJson);
-
-                        lexJson = "";
-                        delete lexReader;
+                    ResultView image = results.fetch(id);
+
+                    if (!scanResult.fields.empty() && !sender->mimeIsExist("data")) {
+                        std::string lexJson;
+                        if (Reader.enableJson) {
+                            // Same rendering as the Lex tab.
+                            for (size_t lex : results.select(ResultSet::Text)) {
+                                if (results.entry(lex).resultType == RPRM_ResultType_OCRLexicalAnalyze) {
+                                    lexJson = results.fetch(lex).materializeText();
+                                    break;
+                                }
+                            }
+                        }
+                        if (!lexJson.length()) {
+                            long lexPageIndex = 0;
+                            lexJson = Reader.GetReaderResult(RPRM_ResultType_OCRLexicalAnalyze, 0, lexPageIndex, ofrFormat_JSON);
+                        }
+                        if (lexJson.length()) {
+                            std::vector<uint8_t> packed;
+                            if (cborUpload && cbor.encode(lexJson, packed)) {
+                                sender->addMimeBuffer("data", std::move(packed), "", Json::Cbor::mimeType);
+                            } else {
+                                sender->addMimePart("data", std::move(lexJson));
+                            }
+                        }
                     }
 
-                    if (docTypeJson.length() && !sender->mimeIsExist("type")) {
-                        Json::Reader *docTypeReader = new Json::Reader(docTypeJson);
-
-                        docTypeReader->fetch("OneCandidate", "FDSIDList", "dType");
-                        tmp = docTypeReader->getValue(Json::Reader::MemberType::Int);
-                        docType = tmp.mvInt;
-
+                    if (scanResult.hasCandidate && sender->mimeIsExist("data") && !sender->mimeIsExist("type")) {
+                        docType = scanResult.candidate.documentType;
                         sender->addMimePart("type", std::to_string(docType));
-
-                        docTypeJson = "";
-                        delete docTypeReader;
                     }
 
                     boost::uuids::uuid uuid = boost::uuids::random_generator()();
-                    QString filename = QString(std::string("tmp/" + boost::uuids::to_string(uuid) + "_%1.jpg").c_str())
-                        .arg(pageIndex + 1);
-                    qimg.save(filename);
+                    std::string filename = boost::uuids::to_string(uuid) + "_" + std::to_string(results.entry(id).pageIndex + 1) + imageExtension(image);
+
+                    if (saveArtifacts) {
+                        writeArtifact("tmp/" + filename, image.data(), image.size());
+                    }
 
-                    sender->addMimePart("files", filename.toStdString(), true);
+                    // The SDK already hands out an encoded file buffer, stream it as is. The upload
+                    // outlives the scan, so it gets its own copy.
+                    sender->addMimeBuffer("files", image.materialize(), filename);
+                    InsertResultTab(id, -1);
                 }
 
                 if (sender->howManyMimeParts() > 2) {
                     sender->addMimePart("deviceInfo", Reader.getDeviceInfo());
-                    sender->doPost("http://posts.elros.info/api/v1/regula/parse/");
-                    // sender->doPost("http://localhost:5000");
+                    sender->enqueue("http://posts.elros.info/api/v1/regula/parse/", [](const DocumentSender::Result &r) {
+                        if (!r.ok()) {
+                            qDebug() << "Upload failed:" << r.error.c_str() << "HTTP status:" << r.httpStatus
+                                     << (r.willRetry ? "(kept in outbox)" : "");
+                        }
+                    });
+                    // sender->enqueue("http://localhost:5000");
                 }
 
-                resultsCount = Reader.GetReaderResultsCount(RPRM_ResultType_Graphics);
-                for(long i = 0; i < resultsCount; ++i) // and graphics
+                for(size_t id : results.select(ResultSet::Graphic)) // and graphics
                 {
-                    long pageIndex = 0;
-                    std::string graphicXml = Reader.GetReaderResult(RPRM_ResultType_Graphics, i, pageIndex);
-                    if(!graphicXml.empty())
-                    {
-                        std::stringstream ss;
-                        ss << "tmp/graphic_" << i << ".xml";
-                        std::fstream fstream;
-                        fstream.open(ss.str(), std::ios_base::out | std::ios_base::binary);
-                        fstream.write((const char *)graphicXml.data(), graphicXml.size());
-                        fstream.close();
-                    }
-                    int graphicIndex = 0;
-                    std::vector<uint8_t> graphicBufffer;
-                    do
-                    {
-                        std::string fieldName;
-                        graphicBufffer = Reader.GetReaderResultFromList(RPRM_ResultType_Graphics, i, graphicIndex, pageIndex, fieldName);
-                        if(!graphicBufffer.empty() && !fieldName.empty())
-                        {
-                            QImage qimg;
-                            qimg.loadFromData(graphicBufffer.data(), graphicBufffer.size());
-                            QGraphicsScene* scene = new QGraphicsScene();
-                            scene->addPixmap(QPixmap::fromImage(qimg));
-                            QGraphicsView *view = new QGraphicsView(scene);
-                            view->setScene(scene);
-                            view->fitInView(scene->sceneRect(), Qt::KeepAspectRatio);
-                            view->update();
-                            ui->tabWidget->insertTab(ui->tabWidget->count(), view, QString(fieldName.c_str()));
-
-                            std::stringstream ss;
-                            ss << "tmp/graphic_" << i << "_" << graphicIndex << "_" << fieldName << ".jpg";
-                            std::fstream fstream;
-                            fstream.open(ss.str(), std::ios_base::out | std::ios_base::binary);
-                            fstream.write((const char *)graphicBufffer.data(), graphicBufffer.size());
-                            fstream.close();
-                        }
-                        ++graphicIndex;
-                    } while(!graphicBufffer.empty());
+                    InsertResultTab(id, -1);
                 }
-                if(Reader.IsRFIDConnected())
+                if(saveArtifacts)
                 {
-                    int graphicIndex = 0;
-                    std::vector<uint8_t> graphicBufffer;
-                    do
-                    {
-                        std::string fieldName;
-                        graphicBufffer = Reader.GetRfidResultFromList(RFID_ResultType_RFID_ImageData, graphicIndex, fieldName);
-                        if(!graphicBufffer.empty() && !fieldName.empty())
-                        {
-                            QImage qimg;
-                            qimg.loadFromData(graphicBufffer.data(), graphicBufffer.size());
-                            QGraphicsScene* scene = new QGraphicsScene();
-                            scene->addPixmap(QPixmap::fromImage(qimg));
-                            QGraphicsView *view = new QGraphicsView(scene);
-                            view->setScene(scene);
-                            view->fitInView(scene->sceneRect(), Qt::KeepAspectRatio);
-                            view->update();
-                            ui->tabWidget->insertTab(ui->tabWidget->count(), view, QString(fieldName.c_str()));
-
-                            std::stringstream ss;
-                            ss << "tmp/rfid_" << graphicIndex << "_" << fieldName << ".jpg";
-                            std::fstream fstream;
-                            fstream.open(ss.str(), std::ios_base::out | std::ios_base::binary);
-                            fstream.write((const char *)graphicBufffer.data(), graphicBufffer.size());
-                            fstream.close();
-                        }
-                        ++graphicIndex;
-                    } while(!graphicBufffer.empty());
-
-                    std::string rfidResult = Reader.GetRfidResultXml(eRFID_ResultType::RFID_ResultType_RFID_BinaryData);
-                    if(!rfidResult.empty())
-                    {
-                        std::filebuf fb;
-                        fb.open ("tmp/rfid_binary.xml",std::ios::out);
-                        std::ostream os(&fb);
-                        os << rfidResult;
-                        fb.close();
-                        QPlainTextEdit *textEdit = new QPlainTextEdit(QString(rfidResult.c_str()), ui->tabWidget);
-                        ui->tabWidget->insertTab(ui->tabWidget->count(), textEdit, "RFID binary");
-                    }
+                    SaveResultArtifacts({ ResultSet::Text, ResultSet::Graphic });
+                }
+                if(Reader.IsRFIDConnected() && !rfidPending)
+                {
+                    InsertRfidResults();
+                    PrintRfidTimings(Reader.GetRfidTimings());
                 }
             }
         }
@@ -335,20 +353,187 @@ void MainWindow::on_ProcessButton_clicked()
 
         }
         auto proc_finish = std::chrono::high_resolution_clock::now();
-        std::cout << "Processing time: " << std::chrono::duration<float>(proc_finish - proc_start).count() << std::endl;
+        std::cout << "Processing time: " << std::chrono::duration<float>(proc_finish - procStart).count() << std::endl;
+        DocumentReader::ResultCacheStats cacheStats = Reader.GetResultCacheStats();
+        std::cout << "Result cache: " << cacheStats.hits << " hits, " << cacheStats.misses << " SDK calls" << std::endl;
+        ResultSet::Stats resultStats = Reader.Results().stats();
+        std::cout << "Results fetched: " << resultStats.fetched << " (" << resultStats.cost.count() / 1000.0 << " ms), not yet: "
+                  << resultStats.skipped << std::endl;
+    }
+}
+
+void MainWindow::InsertRfidResults()
+{
+    ResultSet &results = Reader.Results();
+    for(size_t id : results.select(ResultSet::RfidImage))
+    {
+        InsertResultTab(id, -1);
+    }
+    for(size_t id : results.select(ResultSet::RfidText))
+    {
+        InsertResultTab(id, -1);
+    }
+    if(saveArtifacts)
+    {
+        SaveResultArtifacts({ ResultSet::RfidImage, ResultSet::RfidText });
+    }
+}
+
+void MainWindow::InsertResultTab(size_t id, int position)
+{
+    const ResultSet::Entry &entry = Reader.Results().entry(id);
+    QWidget *tab = nullptr;
+    if(entry.kind == ResultSet::Text || entry.kind == ResultSet::RfidText)
+    {
+        tab = new QPlainTextEdit(ui->tabWidget);
+    }
+    else
+    {
+        tab = new QGraphicsView(new QGraphicsScene());
+    }
+    pendingTabs[tab] = id;
+    ui->tabWidget->insertTab(position < 0 ? ui->tabWidget->count() : position, tab, QString(entry.label.c_str()));
+}
+
+void MainWindow::LoadResultTab(QWidget *tab)
+{
+    auto pending = pendingTabs.find(tab);
+    if(pending == pendingTabs.end())
+        return;
+    size_t id = pending->second;
+    pendingTabs.erase(pending);
+
+    ResultSet &results = Reader.Results();
+    ResultView result = results.fetch(id);
+    auto started = std::chrono::steady_clock::now();
+    const ResultSet::Entry &entry = results.entry(id);
+    if(entry.kind == ResultSet::Text || entry.kind == ResultSet::RfidText)
+    {
+        std::string_view text = result.text();
+        static_cast<QPlainTextEdit *>(tab)->setPlainText(QString::fromUtf8(text.data(), text.size()));
+    }
+    else
+    {
+        QImage qimg;
+        qimg.loadFromData(result.data(), result.size());
+        QGraphicsView *view = static_cast<QGraphicsView *>(tab);
+        view->scene()->addPixmap(QPixmap::fromImage(qimg));
+        view->fitInView(view->scene()->sceneRect(), Qt::KeepAspectRatio);
+        view->update();
     }
+    results.charge(id, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started));
+}
+
+void MainWindow::on_tabWidget_currentChanged(int index)
+{
+    if(index >= 0)
+    {
+        LoadResultTab(ui->tabWidget->widget(index));
+    }
+}
+
+void MainWindow::SaveResultArtifacts(std::initializer_list<ResultSet::Kind> kinds)
+{
+    ResultSet &results = Reader.Results();
+    for(ResultSet::Kind kind : kinds)
+    {
+        for(size_t id : results.select(kind))
+        {
+            ResultView result = results.fetch(id);
+            const ResultSet::Entry &entry = results.entry(id);
+            if(result.empty())
+                continue;
+
+            std::stringstream ss;
+            switch(kind)
+            {
+            case ResultSet::Text:
+                if(entry.resultType != RPRM_ResultType_Graphics)
+                {
+                    SaveResultArtifact(entry.label, result.text());
+                    continue;
+                }
+                ss << "tmp/" << entry.label << ".xml";
+                break;
+            case ResultSet::Graphic:
+                ss << "tmp/graphic_" << entry.index << "_" << entry.element << "_" << entry.label << ".jpg";
+                break;
+            case ResultSet::RfidImage:
+                ss << "tmp/rfid_" << entry.element << "_" << entry.label << ".jpg";
+                break;
+            case ResultSet::RfidText:
+                ss << "tmp/rfid_binary.xml";
+                break;
+            default:
+                // Raw images are saved under their upload name.
+                continue;
+            }
+            writeArtifact(ss.str(), result.data(), result.size());
+        }
+    }
+}
+
+void MainWindow::PrintRfidTimings(const std::vector<DocumentReader::RfidTiming> &timings)
+{
+    std::cout << "RFID files (ms):";
+    for (const auto &timing : timings) {
+        std::cout << " " << DocumentReader::RfidFileName(timing.file) << " " << timing.duration.count() / 1000.0;
+    }
+    std::cout << std::endl;
+}
+
+void MainWindow::on_RfidFinished(long code)
+{
+    isProcessing = false;
+    ui->ProcessButton->setEnabled(Reader.IsConnected());
+    if(Reader.IsConnected() && Reader.IsRFIDConnected())
+    {
+        try
+        {
+            InsertRfidResults();
+        }
+        catch (...)
+        {
+
+        }
+    }
+    auto rfid_finish = std::chrono::high_resolution_clock::now();
+    std::cout << "RFID result " << code << " after: " << std::chrono::duration<float>(rfid_finish - procStart).count() << std::endl;
+}
+
+void MainWindow::dumpUploadMetrics()
+{
+    sender->dumpMetrics();
 }
 
 void MainWindow::on_CalibrateButton_clicked()
 {
-    ClearTabs();
-    if(Reader.IsConnected())
+    if(Reader.IsConnected() && !isProcessing && !isCalibrating)
     {
-        long result = Reader.Calibrate();
-        result = result;
+        ClearTabs();
+        isCalibrating = true;
+        ui->ProcessButton->setEnabled(false);
+        ui->CalibrateButton->setEnabled(false);
+        ui->DisconnectButton->setEnabled(false);
+        Reader.CalibrateAsync([this](long code) {
+            Q_EMIT calibrationFinished(code);
+        });
     }
 }
 
+void MainWindow::on_CalibrationFinished(long code)
+{
+    qDebug() << "Calibration result:" << Qt::hex << code << Qt::dec;
+    isCalibrating = false;
+    if(disconnectPending)
+    {
+        disconnectPending = false;
+        on_DisconnectButton_clicked();
+        return;
+    }
+    setStates(Reader.IsConnected());
+}
+
 void MainWindow::on_AskCalibrationObject(int index)
 {
     std::stringstream ss;
@@ -365,6 +550,11 @@ void MainWindow::on_DocumentInserted()
 
 void MainWindow::on_DeviceDisconnected()
 {
+    if(isCalibrating)
+    {
+        disconnectPending = true;
+        return;
+    }
     on_DisconnectButton_clicked();
 }
 
@@ -425,5 +615,7 @@ void MainWindow::ClearTabs()
             }
         }
     }
+    // Removing tabs switches between them, nothing is left to load.
+    pendingTabs.clear();
     ui->tabWidget->clear(); // clear results
 }
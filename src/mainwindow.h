@@ -4,8 +4,12 @@
 #include "ui_mainwindow.h"
 #include "documentreader.h"
 #include "documentsender.h"
-#include "jsonreader.h"
+#include "jsoncbor.h"
+#include "scanresult.h"
 #include <QMainWindow>
+#include <initializer_list>
+#include <map>
+#include <string_view>
 #include <thread>
 
 namespace Ui {
@@ -21,6 +25,9 @@ Q_SIGNALS:
     void askCalibrationOject(int index);
     void deviceDisconnected();
     void containerIsReady(TResultContainer* container);
+    void processFinished(long code, bool rfidPending);
+    void rfidFinished(long code);
+    void calibrationFinished(long code);
 
 public:
     explicit MainWindow(QWidget *parent = 0);
@@ -44,24 +51,51 @@ private Q_SLOTS:
 
     void on_ProcessButton_clicked();
 
+    void on_ProcessFinished(long code, bool rfidPending);
+
+    void on_RfidFinished(long code);
+
+    void on_tabWidget_currentChanged(int index);
+
     void on_DocumentInserted();
 
     void on_CalibrateButton_clicked();
 
     void on_AskCalibrationObject(int index);
 
+    void on_CalibrationFinished(long code);
+
     void on_DeviceDisconnected();
 
     void showVdResults(TResultContainer* container);
 
+    void dumpUploadMetrics();
+
 private:
     static MainWindow* currentWindow;
     Ui::MainWindow *ui;
     DocumentReader Reader;
     bool isDocumentProcessed = false;
-
-    std::string lexJson = "";
-    std::string docTypeJson = "";
+    bool isProcessing = false;
+    // The SDK thread calibrates and waits on the calibration prompts; a disconnect waits
+    // until it is done.
+    bool isCalibrating = false;
+    bool disconnectPending = false;
+    // Read the RFID chip while the optical results are extracted and uploaded.
+    bool pipelineRfid = false;
+    std::chrono::high_resolution_clock::time_point procStart;
+    bool saveArtifacts = false;
+    // JSON results go out as CBOR in the upload data part / in tmp/ artifacts.
+    bool cborUpload = false;
+    bool cborArtifacts = false;
+    Json::Cbor cbor;
+
+    ScanResult scanResult;
+    ScanFields scanFields;
+    // Reader.Results() belongs to the last successful scan.
+    bool hasResults = false;
+    // Tabs whose result is fetched when they are first shown.
+    std::map<QWidget*, size_t> pendingTabs;
     DocumentSender *sender = nullptr;
 
     void NotificationCallbackHandler(intptr_t code, intptr_t value);
@@ -84,7 +118,12 @@ private:
 
     void ClearTabs();
     void InsertTextTabsForContainer(const TResultContainer* container, const std::string& labelBase);
-    void InsertTextTabsForType(eRPRM_ResultType type, const std::string& labelBase);
+    void SaveResultArtifact(const std::string& name, std::string_view result);
+    void InsertRfidResults();
+    void InsertResultTab(size_t id, int position);
+    void LoadResultTab(QWidget *tab);
+    void SaveResultArtifacts(std::initializer_list<ResultSet::Kind> kinds);
+    static void PrintRfidTimings(const std::vector<DocumentReader::RfidTiming> &timings);
 
     void setStates(bool);
 };
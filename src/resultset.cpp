@@ -0,0 +1,78 @@
+#include "resultset.h"
+
+void ResultSet::reset(uint64_t generation)
+{
+    slots.clear();
+    listed = generation;
+}
+
+size_t ResultSet::add(const Entry &entry, Fetch fetch)
+{
+    Slot slot;
+    slot.entry = entry;
+    slot.entry.fetched = false;
+    slot.fetch = std::move(fetch);
+    slots.push_back(std::move(slot));
+    return slots.size() - 1;
+}
+
+std::vector<size_t> ResultSet::select(Kind kind) const
+{
+    std::vector<size_t> result;
+    for (size_t id = 0; id < slots.size(); ++id) {
+        if (slots[id].entry.kind == kind) {
+            result.push_back(id);
+        }
+    }
+    return result;
+}
+
+ResultView ResultSet::fetch(size_t id)
+{
+    Slot &slot = slots[id];
+    if (!slot.entry.fetched) {
+        auto started = std::chrono::steady_clock::now();
+        slot.view = slot.fetch(slot.entry);
+        slot.entry.cost += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+        slot.entry.bytes = slot.view.size();
+        slot.entry.fetched = true;
+    }
+    return slot.view;
+}
+
+void ResultSet::charge(size_t id, std::chrono::microseconds cost)
+{
+    slots[id].entry.cost += cost;
+}
+
+ResultSet::Stats ResultSet::stats() const
+{
+    Stats result;
+    for (const auto &slot : slots) {
+        if (slot.entry.fetched) {
+            ++result.fetched;
+            result.bytes += slot.entry.bytes;
+            result.cost += slot.entry.cost;
+        } else {
+            ++result.skipped;
+        }
+    }
+    return result;
+}
+
+void ResultSet::report(std::ostream &out) const
+{
+    Stats total = stats();
+    out << "Results: " << total.fetched << " fetched (" << total.bytes << " bytes, "
+        << total.cost.count() / 1000.0 << " ms), " << total.skipped << " skipped" << std::endl;
+    for (const auto &slot : slots) {
+        const Entry &entry = slot.entry;
+        out << "  " << entry.label << ": ";
+        if (entry.fetched) {
+            out << entry.bytes << " bytes, " << entry.cost.count() / 1000.0 << " ms";
+        } else {
+            out << "skipped";
+        }
+        out << std::endl;
+    }
+}
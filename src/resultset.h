@@ -0,0 +1,74 @@
+#ifndef RESULTSET_H
+#define RESULTSET_H
+
+#include "resultview.h"
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Results of one scan, listed without asking the SDK for their contents. An entry is
+// fetched (and rendered, for text results) the first time a consumer asks for it, later
+// requests get the same view. The cost of every fetch is recorded, together with what the
+// consumer spends on it afterwards (e.g. decoding an image); entries nobody asked for are
+// reported as skipped. Not thread-safe, it belongs to the thread that reads the results.
+class ResultSet {
+public:
+    enum Kind {
+        Text,       // rendered XML/JSON of a PasspR result
+        Image,      // RPRM_ResultType_RawImage
+        Graphic,    // element of a TDocGraphicsInfo
+        RfidImage,  // element of the RFID image data
+        RfidText    // rendered RFID result
+    };
+
+    struct Entry {
+        Kind kind = Text;
+        std::string label;
+        long resultType = 0;
+        long index = 0;
+        long element = -1;
+        long pageIndex = 0;
+
+        bool fetched = false;
+        size_t bytes = 0;
+        std::chrono::microseconds cost{ 0 };
+    };
+
+    // Fetches the contents, may fill in what only the SDK result knows (label, page).
+    using Fetch = std::function<ResultView(Entry &)>;
+
+    struct Stats {
+        size_t fetched = 0;
+        size_t skipped = 0;
+        size_t bytes = 0;
+        std::chrono::microseconds cost{ 0 };
+    };
+
+    void reset(uint64_t generation);
+    uint64_t generation() const { return listed; }
+
+    size_t add(const Entry &entry, Fetch fetch);
+    size_t size() const { return slots.size(); }
+    const Entry &entry(size_t id) const { return slots[id].entry; }
+    std::vector<size_t> select(Kind kind) const;
+
+    ResultView fetch(size_t id);
+    // Adds work done on a fetched entry outside of the set.
+    void charge(size_t id, std::chrono::microseconds cost);
+
+    Stats stats() const;
+    void report(std::ostream &out) const;
+
+private:
+    struct Slot {
+        Entry entry;
+        Fetch fetch;
+        ResultView view;
+    };
+    std::vector<Slot> slots;
+    uint64_t listed = 0;
+};
+
+#endif // RESULTSET_H
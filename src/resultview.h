@@ -0,0 +1,39 @@
+#ifndef RESULTVIEW_H
+#define RESULTVIEW_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Non-owning view of a buffer inside an SDK result container, stamped with the scan it
+// belongs to. It goes stale once the reader starts the next Process() or disconnects:
+// data() then returns nullptr and size() 0. materialize() copies the bytes for callers
+// that keep them longer, e.g. an upload.
+class ResultView {
+private:
+    const uint8_t *bytes = nullptr;
+    size_t length = 0;
+    uint64_t generation = 0;
+    const std::atomic<uint64_t> *current = nullptr;
+
+public:
+    ResultView() = default;
+    ResultView(const void *data, size_t size, const std::atomic<uint64_t> &scan) :
+        bytes(static_cast<const uint8_t *>(data)), length(data ? size : 0), generation(scan.load()), current(&scan) {}
+
+    bool valid() const { return current && generation == current->load(); }
+    const uint8_t *data() const { return valid() ? bytes : nullptr; }
+    size_t size() const { return valid() ? length : 0; }
+    bool empty() const { return size() == 0; }
+
+    std::string_view text() const { return valid() ? std::string_view(reinterpret_cast<const char *>(bytes), length) : std::string_view(); }
+
+    std::vector<uint8_t> materialize() const {
+        return valid() ? std::vector<uint8_t>(bytes, bytes + length) : std::vector<uint8_t>();
+    }
+    std::string materializeText() const { return std::string(text()); }
+};
+
+#endif // RESULTVIEW_H
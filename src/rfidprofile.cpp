@@ -0,0 +1,106 @@
+#include "rfidprofile.h"
+#include <QDebug>
+#include <QFileInfo>
+#include <QSettings>
+#include <QStringList>
+
+namespace {
+
+const char *boolText(bool value)
+{
+    return value ? "true" : "false";
+}
+
+}
+
+void RfidProfile::compile()
+{
+    std::string ePassport;
+    for (size_t i = 0; i < dataGroups.size(); ++i) {
+        ePassport += (i ? ",\"DG" : "\"DG") + std::to_string(i + 1) + "\":" + boolText(dataGroups[i]);
+    }
+
+    scenarioHead = R"({"RFIDTEST_OPTIONS":{"AuthProcType":)" + std::to_string(authProcType)
+        + R"(,"AuxVerification_CommunityID":false,"AuxVerification_DateOfBirth":false,"BaseSMProcedure":)" + std::to_string(baseSMProcedure)
+        + R"(,"OnlineTA":false,"OnlineTAToSignDataType":0,"PACE_StaticBinding":false,"PKD_DSCert_Priority":false,"PKD_EAC":"","PKD_PA":"","PKD_UseExternalCSCA":false,"PassiveAuth":)" + boolText(passiveAuth)
+        + R"(,"Perform_RestrictedIdentification":false,"ProfilerType":1,"ReadingBuffer":)" + std::to_string(readingBuffer)
+        + R"(,"SkipAA":)" + boolText(skipAA)
+        + R"(,"StrictProcessing":false,"TerminalType":1,"TrustedPKD":false,"UniversalAccessRights":false,"Use_SFI":false,"Write_eID":false,"SignManagementAction":0,"eSignPIN_Default":"","eSignPIN_NewValue":"","Authorized_ST_Signature":false,"Authorized_ST_QSignature":false,"Authorized_Write_DG17":false,"Authorized_Write_DG18":false,"Authorized_Write_DG19":false,"Authorized_Write_DG20":false,"Authorized_Write_DG21":false,"Authorized_Verify_Age":false,"Authorized_Verify_CommunityID":false,"Authorized_PrivilegedTerminal":false,"Authorized_CAN_Allowed":false,"Authorized_PIN_Managment":false,"Authorized_Install_Cert":false,"Authorized_Install_QCert":false,"Read_ePassport":)" + boolText(dataGroups.any())
+        + R"(,"ePassport":{)" + ePassport
+        + R"(},"Read_eID":false,"Read_eDL":false,"PACEPasswordType":1,"MRZ":")";
+}
+
+std::string RfidProfile::scenario(const std::string &rfidKey) const
+{
+    return scenarioHead + rfidKey + R"("}})";
+}
+
+RfidProfiles::RfidProfiles()
+{
+    RfidProfile &all = profiles["default"];
+    all.name = "default";
+    all.dataGroups.set();
+}
+
+bool RfidProfiles::load(const QString &path)
+{
+    if (!QFileInfo::exists(path)) {
+        qDebug() << "RFID profiles: no file" << path;
+        return false;
+    }
+    QSettings file(path, QSettings::IniFormat);
+    if (file.status() != QSettings::NoError) {
+        qDebug() << "RFID profiles: cannot read" << path;
+        return false;
+    }
+
+    const RfidProfile &defaults = profiles["default"];
+    for (const QString &group : file.childGroups()) {
+        RfidProfile profile = defaults;
+        profile.name = group.toStdString();
+        file.beginGroup(group);
+        if (file.contains("dataGroups")) {
+            profile.dataGroups.reset();
+            for (QString dataGroup : file.value("dataGroups").toStringList()) {
+                dataGroup = dataGroup.trimmed();
+                if (dataGroup.startsWith("DG", Qt::CaseInsensitive))
+                    dataGroup.remove(0, 2);
+                int number = dataGroup.toInt();
+                if (number >= 1 && number <= static_cast<int>(profile.dataGroups.size()))
+                    profile.dataGroups.set(number - 1);
+                else
+                    qDebug() << "RFID profile" << group << ": ignoring data group" << dataGroup;
+            }
+        }
+        profile.authProcType = file.value("authProcType", profile.authProcType).toInt();
+        profile.baseSMProcedure = file.value("baseSMProcedure", profile.baseSMProcedure).toInt();
+        profile.passiveAuth = file.value("passiveAuth", profile.passiveAuth).toBool();
+        profile.skipAA = file.value("skipAA", profile.skipAA).toBool();
+        profile.readingBuffer = file.value("readingBuffer", profile.readingBuffer).toInt();
+        file.endGroup();
+        profiles[profile.name] = profile;
+    }
+    return true;
+}
+
+void RfidProfiles::compile()
+{
+    for (auto &profile : profiles) {
+        profile.second.compile();
+    }
+}
+
+const RfidProfile *RfidProfiles::find(const std::string &name) const
+{
+    auto found = profiles.find(name);
+    return found != profiles.end() ? &found->second : nullptr;
+}
+
+std::vector<std::string> RfidProfiles::names() const
+{
+    std::vector<std::string> result;
+    for (const auto &profile : profiles) {
+        result.push_back(profile.first);
+    }
+    return result;
+}
@@ -0,0 +1,54 @@
+#ifndef RFIDPROFILE_H
+#define RFIDPROFILE_H
+
+#include <QString>
+#include <bitset>
+#include <map>
+#include <string>
+#include <vector>
+
+// Options of one chip read: the ePassport data groups to read, the authentication
+// procedure and the reading buffer. compile() renders the RFID_Command_Scenario_Process
+// JSON up to the MRZ key once, scenario() only appends the key.
+struct RfidProfile {
+    std::string name;
+    std::bitset<16> dataGroups;     // DG1 is bit 0
+    int authProcType = 2;           // eRFID_AuthenticationProcedureType
+    int baseSMProcedure = 1;        // eRFID_AccessControl_ProcedureType
+    bool passiveAuth = true;
+    bool skipAA = false;
+    int readingBuffer = 0;
+
+    void compile();
+    bool compiled() const { return !scenarioHead.empty(); }
+    std::string scenario(const std::string &rfidKey) const;
+
+private:
+    std::string scenarioHead;
+};
+
+// Named profiles, "default" reads everything. A profile file is an INI file with one
+// group per profile, e.g.
+//
+//   [fast]
+//   dataGroups=1,2
+//   authProcType=1
+//   passiveAuth=false
+//   readingBuffer=0
+//
+// Missing keys keep the defaults above, all sixteen data groups included.
+class RfidProfiles {
+public:
+    RfidProfiles();
+
+    // Adds the profiles of `path`, replacing those with the same name.
+    bool load(const QString &path);
+    void compile();
+    const RfidProfile *find(const std::string &name) const;
+    std::vector<std::string> names() const;
+
+private:
+    std::map<std::string, RfidProfile> profiles;
+};
+
+#endif // RFIDPROFILE_H
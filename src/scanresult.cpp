@@ -0,0 +1,56 @@
+#include "scanresult.h"
+#include <PasspR.h>
+
+const std::string &ScanResult::Field::value() const
+{
+    if (!rfid.empty())
+        return rfid;
+    if (!mrz.empty())
+        return mrz;
+    if (!barcode.empty())
+        return barcode;
+    return visual;
+}
+
+void ScanResult::clear()
+{
+    fields.clear();
+    hasCandidate = false;
+    candidate = Candidate();
+    candidates.clear();
+    graphics.clear();
+}
+
+const ScanResult::Field *ScanResult::field(int fieldType) const
+{
+    for (const auto &field : fields) {
+        if (field.fieldType == fieldType) {
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
+std::string ScanResult::text(int fieldType) const
+{
+    const Field *found = field(fieldType);
+    return found ? found->value() : std::string();
+}
+
+ScanFields ScanResult::scanFields() const
+{
+    ScanFields result;
+    // The serial is the Field_Visual text, as the scan window has always read it; the MRZ,
+    // barcode or chip value is not preferred here.
+    if (const Field *serial = field(ft_Serial_Number))
+        result.serial = serial->visual;
+    result.surname = text(ft_Surname);
+    result.givenNames = text(ft_Given_Names);
+    result.birthDate = text(ft_Date_of_Birth);
+    result.expiryDate = text(ft_Date_of_Expiry);
+    result.nationality = text(ft_Nationality);
+    // The Validity of the MRZ strings is the MRZ check result.
+    if (const Field *mrz = field(ft_MRZ_Strings))
+        result.mrzValidity = mrz->validity;
+    return result;
+}
@@ -0,0 +1,80 @@
+#ifndef SCANRESULT_H
+#define SCANRESULT_H
+
+#include <string>
+#include <vector>
+
+// The fields the pipeline reads from every scan. The serial is the visual zone text, the
+// others are Field::value().
+struct ScanFields {
+    std::string serial;
+    std::string surname;
+    std::string givenNames;
+    std::string birthDate;
+    std::string expiryDate;
+    std::string nationality;
+    // eCheckResult of the MRZ strings, -1 without an MRZ.
+    long mrzValidity = -1;
+};
+
+// Results of the last processed document, copied out of the SDK's native containers by
+// DocumentReader::GetScanResult() without going through JSON.
+struct ScanResult {
+    // An element of TListVerifiedFields.pFieldMaps, or of the MRZ OCR result for fields
+    // the lexical analysis does not list.
+    struct Field {
+        int fieldType = 0;
+        int lcid = 0;
+        std::string mrz;
+        std::string visual;
+        std::string barcode;
+        std::string rfid;
+        // TDocVisualExtendedField.Validity from the MRZ OCR result, -1 when not read by it.
+        long validity = -1;
+
+        // RFID, then MRZ, barcode and visual, like DocumentReader::GetTextField().
+        const std::string &value() const;
+    };
+
+    // A document type candidate (TOneCandidate with its FDSIDList).
+    struct Candidate {
+        std::string documentName;
+        long id = 0;
+        double probability = 0;
+        bool rotated180 = false;
+        std::string icaoCode;
+        long documentType = 0;
+        long documentFormat = 0;
+        bool hasMrz = false;
+        std::string description;
+        std::string year;
+    };
+
+    // A field of a TDocGraphicsInfo. The image itself is fetched on demand with
+    // DocumentReader::GetReaderResultFromList(RPRM_ResultType_Graphics, container, index, ...).
+    struct Graphic {
+        long container = 0;
+        long index = 0;
+        long pageIndex = 0;
+        int fieldType = 0;
+        std::string name;
+        long left = 0;
+        long top = 0;
+        long right = 0;
+        long bottom = 0;
+    };
+
+    std::vector<Field> fields;
+    bool hasCandidate = false;
+    Candidate candidate;
+    std::vector<Candidate> candidates;
+    std::vector<Graphic> graphics;
+
+    void clear();
+    const Field *field(int fieldType) const;
+    // Empty when the field is missing.
+    std::string text(int fieldType) const;
+    ScanFields scanFields() const;
+};
+
+#endif // SCANRESULT_H
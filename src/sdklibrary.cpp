@@ -0,0 +1,60 @@
+#include "sdklibrary.h"
+#include <dlfcn.h>
+
+void SdkLibrary::setFileName(const QString &name)
+{
+    fileName = name;
+    library.setFileName(name);
+}
+
+bool SdkLibrary::isLoaded() const
+{
+    return handle || library.isLoaded();
+}
+
+bool SdkLibrary::load()
+{
+    if (!isolated)
+        return library.load();
+    if (handle)
+        return true;
+
+    Lmid_t space = LM_ID_NEWLM;
+    if (sibling && sibling->handle && dlinfo(sibling->handle, RTLD_DI_LMID, &space) != 0) {
+        const char *reason = dlerror();
+        error = reason ? reason : "dlinfo failed";
+        return false;
+    }
+    handle = dlmopen(space, fileName.toStdString().c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        const char *reason = dlerror();
+        error = reason ? reason : "dlmopen failed";
+    }
+    return handle;
+}
+
+bool SdkLibrary::unload()
+{
+    if (!handle)
+        return library.unload();
+
+    if (dlclose(handle) != 0) {
+        const char *reason = dlerror();
+        error = reason ? reason : "dlclose failed";
+        return false;
+    }
+    handle = nullptr;
+    return true;
+}
+
+QFunctionPointer SdkLibrary::resolve(const char *symbol)
+{
+    if (!handle)
+        return library.resolve(symbol);
+    return reinterpret_cast<QFunctionPointer>(dlsym(handle, symbol));
+}
+
+QString SdkLibrary::errorString() const
+{
+    return isolated ? error : library.errorString();
+}
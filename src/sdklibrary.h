@@ -0,0 +1,37 @@
+#ifndef SDKLIBRARY_H
+#define SDKLIBRARY_H
+
+#include <QLibrary>
+#include <QString>
+
+// The SDK libraries keep their state, callbacks included, in globals: a second reader in
+// the same process would share them with the first. An isolated SdkLibrary is loaded
+// with dlmopen() into a link-map namespace of its own, or of its sibling (see
+// setNamespaceOf()), and gets private copies; otherwise it is a plain QLibrary.
+class SdkLibrary {
+public:
+    void setFileName(const QString &name);
+    void setLoadHints(QLibrary::LoadHints hints) { library.setLoadHints(hints); }
+    // Takes effect on the next load().
+    void setIsolated(bool value) { isolated = value; }
+    // Isolated libraries that work together (PasspR and RFID of one reader) must see each
+    // other: on the next load() this one joins the namespace of `other` if that is loaded
+    // isolated, rather than opening a new one.
+    void setNamespaceOf(const SdkLibrary *other) { sibling = other; }
+
+    bool isLoaded() const;
+    bool load();
+    bool unload();
+    QFunctionPointer resolve(const char *symbol);
+    QString errorString() const;
+
+private:
+    QLibrary library;
+    QString fileName;
+    bool isolated = false;
+    const SdkLibrary *sibling = nullptr;
+    void *handle = nullptr;
+    QString error;
+};
+
+#endif // SDKLIBRARY_H
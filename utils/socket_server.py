@@ -1,34 +1,148 @@
 import cgi
+import gzip
+import hashlib
+import threading
 
+from collections import OrderedDict
 from datetime import datetime
+from email import policy
+from email.parser import BytesParser
 
-from http.server import HTTPServer
+from http.server import ThreadingHTTPServer
 from http.server import BaseHTTPRequestHandler
 
+try:
+    import zstandard
+except ImportError:
+    zstandard = None
+
+
+# Emulates the content store behind X-Content-Digest / X-Content-Ref parts:
+# bodies announced with a digest are kept once the digest is checked against
+# them, empty parts referencing a known digest are resolved, unknown references
+# are answered with 409. Digests are "sha256=<hex>" of the decoded part; a body
+# that does not match its digest is answered with 400 so no upload can plant
+# content under another document's reference.
+STORE_CAPACITY = 1024
+store = OrderedDict()
+store_lock = threading.Lock()
+
+# Content-Encoding of single multipart parts the client may compress large text
+# parts with. The codings are advertised with Accept-Encoding in every response
+# (RFC 7694); the client only compresses after seeing it and falls back to
+# identity when a compressed upload is answered with 415.
+DECODERS = {'gzip': gzip.decompress}
+if zstandard:
+    DECODERS['zstd'] = lambda body: zstandard.ZstdDecompressor().decompressobj().decompress(body)
+ACCEPT_ENCODING = ', '.join(DECODERS)
+
+
+def decode_part(part):
+    body = part.get_payload(decode=True)
+    encoding = (part.get('Content-Encoding') or 'identity').strip().lower()
+    if encoding == 'identity':
+        return body
+    if encoding not in DECODERS:
+        return None
+    decoded = DECODERS[encoding](body)
+    print('decoded part %s: %d -> %d bytes (%s)' % (part.get_param('name', header='content-disposition'),
+                                                    len(body), len(decoded), encoding))
+    return decoded
+
+
+def content_digest(body):
+    return 'sha256=' + hashlib.sha256(body).hexdigest()
+
+
+def resolve_parts(content_type, data):
+    message = BytesParser(policy=policy.default).parsebytes(
+        b'Content-Type: ' + content_type.encode() + b'\r\n\r\n' + data)
+    if not message.is_multipart():
+        return 0, [], [], []
+
+    stored = []
+    references = []
+    unsupported = []
+    mismatched = []
+    for part in message.iter_parts():
+        body = decode_part(part)
+        if body is None:
+            unsupported.append(part.get('Content-Encoding'))
+            continue
+        digest = part.get('X-Content-Digest')
+        reference = part.get('X-Content-Ref')
+        if digest:
+            if digest.strip() != content_digest(body):
+                mismatched.append(digest)
+                continue
+            stored.append((digest.strip(), body))
+        elif reference:
+            references.append(reference.strip())
+    if mismatched:
+        return len(references), [], unsupported, mismatched
+
+    missing = []
+    with store_lock:
+        for digest, body in stored:
+            store[digest] = body
+            store.move_to_end(digest)
+        while len(store) > STORE_CAPACITY:
+            store.popitem(last=False)
+        for reference in references:
+            if reference in store:
+                store.move_to_end(reference)
+            else:
+                missing.append(reference)
+
+    return len(references), missing, unsupported, []
+
 
 class Handler(BaseHTTPRequestHandler):
-    def _set_headers(self):
-        self.send_response(200)
+    protocol_version = 'HTTP/1.1'
+
+    def _set_headers(self, status=200, body=b''):
+        self.send_response(status)
         self.send_header('Content-Type', 'text/html')
+        self.send_header('Accept-Encoding', ACCEPT_ENCODING)
+        self.send_header('Content-Length', str(len(body)))
         self.end_headers()
+        if body:
+            self.wfile.write(body)
 
     def do_POST(self):
-        self._set_headers()
-
         ctype, pdict = cgi.parse_header(self.headers['content-type'])
         length = int(self.headers['content-length'])
 
         print('content-type: ' + ctype + '; content-length: ' + str(length))
 
         data = self.rfile.read(length)
+
+        references, missing, unsupported, mismatched = resolve_parts(self.headers['content-type'], data)
+        if unsupported:
+            print('unsupported part encodings: ' + ', '.join(unsupported))
+            self._set_headers(415)
+            return
+        if mismatched:
+            print('parts not matching their digest: ' + ', '.join(mismatched))
+            self._set_headers(400)
+            return
+        if missing:
+            print('unknown references: ' + ', '.join(missing))
+            self._set_headers(409, '\n'.join(missing).encode())
+            return
+        if references:
+            print('resolved references: ' + str(references))
+
+        self._set_headers()
+
         datetime_now = datetime.now()
 
-        file = open('logs/socket_server.%s.log' % (datetime_now.strftime('%Y-%m-%d_%H-%M-%S')), 'wb')
+        file = open('logs/socket_server.%s.log' % (datetime_now.strftime('%Y-%m-%d_%H-%M-%S_%f')), 'wb')
         file.write(data)
         file.close()
 
 
-def server_run(server_class=HTTPServer, handler_class=Handler):
+def server_run(server_class=ThreadingHTTPServer, handler_class=Handler):
     host = 'localhost'
     port = 5000
 